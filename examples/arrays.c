@@ -0,0 +1,53 @@
+// Arrays and buffers are compared as one block. A failure reports how many elements differ and a
+// window of 4 elements around the first one, however long the arrays are.
+//
+//   $ gcc examples/arrays.c src/souffle.c src/hashy.c -g -lm && ./a.out
+
+#include <math.h>
+
+#include "../src/souffle.h"
+
+#define LEN 100000
+
+TEST(arrays, one_element_off) {
+    int *expected = malloc(LEN * sizeof(int));
+    int *actual = malloc(LEN * sizeof(int));
+    assert(expected && actual);
+    for (int i = 0; i < LEN; ++i) {
+        expected[i] = actual[i] = i;
+    }
+    actual[54321] = -1;
+    EXPECT_INT_ARR_EQ(expected, actual, LEN);
+    free(expected);
+    free(actual);
+}
+
+TEST(arrays, unsigned_equal) {
+    uint16_t expected[] = {1, 2, 3, 65535};
+    uint16_t actual[] = {1, 2, 3, 65535};
+    ASSERT_UINT_ARR_EQ(expected, actual, 4);
+}
+
+// float results rarely match exactly: allow an absolute error or a few ulps. The second check
+// fails on the element changed in between.
+TEST(arrays, float_near) {
+    double expected[64];
+    double actual[64];
+    for (int i = 0; i < 64; ++i) {
+        expected[i] = sin(i * 0.1);
+        actual[i] = expected[i] + 1e-12;
+    }
+    ASSERT_FLOAT_ARR_NEAR(expected, actual, 64, 1e-9, 0);
+    actual[10] = 0.5;
+    ASSERT_FLOAT_ARR_NEAR(expected, actual, 64, 1e-9, 4);
+}
+
+TEST(arrays, memory) {
+    typedef struct Header {
+        char magic[4];
+        uint32_t version;
+    } Header;
+    Header expected = {{'S', 'F', 'L', 'E'}, 2};
+    Header actual = {{'S', 'F', 'L', 'E'}, 3};
+    ASSERT_MEM_EQ(&expected, &actual, sizeof(Header));
+}
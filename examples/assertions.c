@@ -0,0 +1,41 @@
+// Assertion operands are evaluated exactly once, and compared in their common type like the C
+// operators do.
+//
+//   $ gcc examples/assertions.c src/souffle.c src/hashy.c -g -lm && ./a.out
+
+#include <math.h>
+
+#include "../src/souffle.h"
+
+typedef struct Counter {
+    int next;
+} Counter;
+
+static int
+counter_next(Counter *counter) {
+    return counter->next++;
+}
+
+TEST(assertions, single_evaluation) {
+    Counter counter = {0};
+    ASSERT_EQ(counter_next(&counter), 0);
+    ASSERT_EQ(counter_next(&counter), 1);
+    ASSERT_LT(counter_next(&counter), 3);
+    ASSERT_EQ(counter.next, 3);
+}
+
+TEST(assertions, mixed_types) {
+    long long big = 1LL << 40;
+    ASSERT_GT(big, 1);
+    ASSERT_EQ(2.0f, 2);
+    ASSERT_EQ((unsigned char)200, 200);
+}
+
+// -1 converts to UINT_MAX, the same as `-1 < 1u` is false in C.
+TEST(assertions, usual_conversions) { ASSERT_LT(-1, 1u); }
+
+// a NaN fails every comparison but ASSERT_NE.
+TEST(assertions, nan) {
+    ASSERT_NE(NAN, NAN);
+    ASSERT_EQ(NAN, NAN);
+}
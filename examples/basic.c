@@ -77,7 +77,7 @@ TEST(arr_suite, array_check) {
     ASSERT_INT_ARR_EQ(a, b, 3);
 }
 
-TEST(main_suite, long_test) {
+TEST(main_suite, long_test, .tags = "slow") {
     for (size_t i = 0; i < 3; i++) {
 #ifndef _WIN32
         sleep(1);
@@ -88,7 +88,7 @@ TEST(main_suite, long_test) {
     }
 }
 
-TEST(main_suite, timeout_test) {
+TEST(main_suite, timeout_test, .tags = "slow") {
     for (size_t i = 0; i < 10000000000; i++) {
 #ifndef _WIN32
         sleep(1);
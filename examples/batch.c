@@ -0,0 +1,30 @@
+// SOUFFLE_MODE=batch runs each suite in a single child. The tests share the process, and when one
+// crashes a new child picks the suite up from the next test.
+//
+//   $ gcc examples/batch.c src/souffle.c src/hashy.c -g -lm && SOUFFLE_MODE=batch ./a.out
+
+#include <signal.h>
+
+#include "../src/souffle.h"
+
+static int calls = 0;
+
+TEST(counter, first) {
+    calls++;
+    ASSERT_EQ(calls, 1);
+}
+
+// in batch mode the second test sees what the first one left behind.
+TEST(counter, second) {
+    calls++;
+    LOG_MSG("calls: %d\n", calls);
+    ASSERT_GTE(calls, 1);
+}
+
+TEST(counter, crash) { raise(SIGSEGV); }
+
+// runs in the child started after the crash, so the count starts over.
+TEST(counter, after_crash) {
+    calls++;
+    ASSERT_EQ(calls, 1);
+}
@@ -0,0 +1,42 @@
+// BENCH defines a microbenchmark. Only SOUFFLE_BENCH=1 runs them, and then nothing else:
+//
+//   $ gcc examples/bench.c src/souffle.c src/hashy.c -g -O2 -lm
+//   $ ./a.out                                     # the tests
+//   $ SOUFFLE_BENCH=1 ./a.out                     # the benchmarks
+//   $ SOUFFLE_BENCH=1 SOUFFLE_BENCH_CLOCK=tsc ./a.out
+
+#include "../src/souffle.h"
+
+static uint64_t
+fnv1a(const unsigned char *key, size_t len) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < len; ++i) {
+        hash = (hash ^ key[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+TEST(hash, fnv1a_known_value) {
+    ASSERT_EQ(fnv1a((const unsigned char *)"a", 1), 0xaf63dc4c8601ec8cULL);
+}
+
+// anything before BENCH_LOOP is untimed setup.
+BENCH(hash, fnv1a_64_bytes) {
+    unsigned char key[64];
+    for (size_t i = 0; i < sizeof(key); ++i) {
+        key[i] = (unsigned char)i;
+    }
+    BENCH_LOOP {
+        uint64_t hash = fnv1a(key, sizeof(key));
+        DO_NOT_OPTIMIZE(hash);
+    }
+}
+
+// CLOBBER_MEMORY keeps the stores from being dropped or merged across iterations.
+BENCH(memory, memset_4k) {
+    static unsigned char page[4096];
+    BENCH_LOOP {
+        memset(page, 0xab, sizeof(page));
+        CLOBBER_MEMORY();
+    }
+}
@@ -0,0 +1,48 @@
+// Benchmark samples can be saved as a baseline, and later runs compared with it. A benchmark is
+// REGRESSED when it is significantly slower (Mann-Whitney U, p < 0.01) and its median grew by more
+// than SOUFFLE_BENCH_THRESHOLD percent:
+//
+//   $ gcc examples/bench_baseline.c src/souffle.c src/hashy.c -g -O2 -lm
+//   $ SOUFFLE_BENCH=1 SOUFFLE_BENCH_SAVE=base.txt ./a.out
+//   $ SOUFFLE_BENCH=1 SOUFFLE_BENCH_BASELINE=base.txt ./a.out          # within noise
+//   $ SLOWER=1 SOUFFLE_BENCH=1 SOUFFLE_BENCH_BASELINE=base.txt ./a.out # sum_array regressed
+//
+// On a noisy machine (a shared VM, frequency scaling) raise the threshold, for example with
+// SOUFFLE_BENCH_THRESHOLD=20.
+
+#include "../src/souffle.h"
+
+#define LEN 4096
+
+static int64_t
+sum(const int32_t *values, size_t len) {
+    int64_t total = 0;
+    for (size_t i = 0; i < len; ++i) {
+        total += values[i];
+    }
+    return total;
+}
+
+BENCH(baseline, sum_array) {
+    static int32_t values[LEN];
+    for (size_t i = 0; i < LEN; ++i) {
+        values[i] = (int32_t)i;
+    }
+    // SLOWER=1 does the work twice, as a regression would.
+    int passes = getenv("SLOWER") ? 2 : 1;
+    BENCH_LOOP {
+        for (int pass = 0; pass < passes; ++pass) {
+            DO_NOT_OPTIMIZE(values);
+            int64_t total = sum(values, LEN);
+            DO_NOT_OPTIMIZE(total);
+        }
+    }
+}
+
+BENCH(baseline, unchanged) {
+    uint64_t x = 1;
+    BENCH_LOOP {
+        x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+        DO_NOT_OPTIMIZE(x);
+    }
+}
@@ -0,0 +1,54 @@
+// With `.range = {min, max}` a benchmark runs once per argument, min doubling up to max, and the
+// times are fitted to O(1), O(log n), O(n), O(n log n) and O(n^2):
+//
+//   $ gcc examples/bench_range.c src/souffle.c src/hashy.c -g -O2 -lm
+//   $ SOUFFLE_BENCH=1 ./a.out
+
+#include "../src/souffle.h"
+
+static int
+compare_ints(const void *a, const void *b) {
+    int x = *(const int *)a;
+    int y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+static void
+fill_reversed(int *values, uint64_t n) {
+    for (uint64_t i = 0; i < n; ++i) {
+        values[i] = (int)(n - i);
+    }
+}
+
+// expect O(n log n).
+BENCH(sort, qsort, .range = {64, 1 << 16}) {
+    uint64_t n = BENCH_ARG;
+    int *values = malloc(n * sizeof(int));
+    assert(values);
+    BENCH_LOOP {
+        fill_reversed(values, n);
+        qsort(values, n, sizeof(int), compare_ints);
+        CLOBBER_MEMORY();
+    }
+    free(values);
+}
+
+// expect O(n^2).
+BENCH(sort, insertion, .range = {32, 1 << 11}) {
+    uint64_t n = BENCH_ARG;
+    int *values = malloc(n * sizeof(int));
+    assert(values);
+    BENCH_LOOP {
+        fill_reversed(values, n);
+        for (uint64_t i = 1; i < n; ++i) {
+            int value = values[i];
+            uint64_t j = i;
+            for (; j > 0 && values[j - 1] > value; --j) {
+                values[j] = values[j - 1];
+            }
+            values[j] = value;
+        }
+        CLOBBER_MEMORY();
+    }
+    free(values);
+}
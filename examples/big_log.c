@@ -0,0 +1,18 @@
+// The test process writes its result and log straight into memory shared with the runner, which
+// takes the log as soon as the test is done. A single log can take up to 256 MiB.
+//
+//   $ gcc examples/big_log.c src/souffle.c src/hashy.c -g -lm && ./a.out | tail
+
+#include "../src/souffle.h"
+
+TEST(logs, many_lines) {
+    for (int i = 0; i < 100000; ++i) {
+        LOG_MSG("line %d of the log\n", i);
+    }
+    FAIL_TEST();
+}
+
+TEST(logs, passing_test_logs_too) {
+    LOG_MSG("logs are printed for passing tests as well\n");
+    ASSERT_TRUE(true);
+}
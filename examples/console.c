@@ -0,0 +1,44 @@
+// The console streams results in registration order as soon as they are known, through a fixed-size
+// buffer, so a run of thousands of tests prints as it goes and uses constant memory.
+// SOUFFLE_QUIET=1 leaves out the tests that passed:
+//
+//   $ gcc examples/console.c src/souffle.c src/hashy.c -g -lm
+//   $ ./a.out
+//   $ SOUFFLE_QUIET=1 ./a.out
+
+#include "../src/souffle.h"
+
+// tests n100 to n999, n737 fails.
+#define CHECK(n) ASSERT_NE((n), 737)
+#define TEN(prefix)                                                                                \
+    TEST(many, n##prefix##0) { CHECK(prefix##0); }                                                 \
+    TEST(many, n##prefix##1) { CHECK(prefix##1); }                                                 \
+    TEST(many, n##prefix##2) { CHECK(prefix##2); }                                                 \
+    TEST(many, n##prefix##3) { CHECK(prefix##3); }                                                 \
+    TEST(many, n##prefix##4) { CHECK(prefix##4); }                                                 \
+    TEST(many, n##prefix##5) { CHECK(prefix##5); }                                                 \
+    TEST(many, n##prefix##6) { CHECK(prefix##6); }                                                 \
+    TEST(many, n##prefix##7) { CHECK(prefix##7); }                                                 \
+    TEST(many, n##prefix##8) { CHECK(prefix##8); }                                                 \
+    TEST(many, n##prefix##9) { CHECK(prefix##9); }
+#define HUNDRED(prefix)                                                                            \
+    TEN(prefix##0)                                                                                 \
+    TEN(prefix##1)                                                                                 \
+    TEN(prefix##2)                                                                                 \
+    TEN(prefix##3)                                                                                 \
+    TEN(prefix##4)                                                                                 \
+    TEN(prefix##5)                                                                                 \
+    TEN(prefix##6)                                                                                 \
+    TEN(prefix##7)                                                                                 \
+    TEN(prefix##8)                                                                                 \
+    TEN(prefix##9)
+
+HUNDRED(1)
+HUNDRED(2)
+HUNDRED(3)
+HUNDRED(4)
+HUNDRED(5)
+HUNDRED(6)
+HUNDRED(7)
+HUNDRED(8)
+HUNDRED(9)
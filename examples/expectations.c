@@ -0,0 +1,33 @@
+// EXPECT_* assertions log a failure and let the test carry on, so one run reports every wrong
+// field. Only the first 100 failures of a test are logged, the rest are counted.
+//
+//   $ gcc examples/expectations.c src/souffle.c src/hashy.c -g -lm && ./a.out
+
+#include "../src/souffle.h"
+
+typedef struct Config {
+    int version;
+    const char *name;
+    unsigned flags;
+} Config;
+
+TEST(expectations, every_field) {
+    Config config = {.version = 1, .name = "souffle", .flags = 0x1};
+    EXPECT_EQ(config.version, 2);
+    EXPECT_STR_EQ(config.name, "souffle");
+    EXPECT_EQ(config.flags, 0x3);
+}
+
+// a runaway loop of failures doesn't flood the log.
+TEST(expectations, capped) {
+    for (int i = 0; i < 1000; ++i) {
+        EXPECT_EQ(i % 7, 0);
+    }
+}
+
+// a fatal assertion still ends the test at once.
+TEST(expectations, then_assert) {
+    EXPECT_EQ(1, 2);
+    ASSERT_EQ(3, 4);
+    EXPECT_EQ(5, 6);
+}
@@ -0,0 +1,34 @@
+// SOUFFLE_FAIL_FAST stops the run once that many tests failed: no new test starts, the ones still
+// running are killed, and the summary counts the tests that never ran.
+//
+//   $ gcc examples/fail_fast.c src/souffle.c src/hashy.c -g -lm && SOUFFLE_FAIL_FAST=1 ./a.out
+
+#include <time.h>
+
+#include "../src/souffle.h"
+
+static void
+sleep_ms(long ms) {
+    struct timespec ts = {.tv_sec = ms / 1000, .tv_nsec = (ms % 1000) * 1000000};
+    while (nanosleep(&ts, &ts) == -1) {
+    }
+}
+
+TEST(fail_fast, long_running) {
+    sleep_ms(3000);
+    ASSERT_TRUE(true);
+}
+
+TEST(fail_fast, broken) {
+    sleep_ms(100);
+    ASSERT_EQ(1, 2);
+}
+
+TEST(fail_fast, also_broken) { ASSERT_EQ(3, 4); }
+
+TEST(fail_fast, fine) { ASSERT_EQ(5, 5); }
+
+TEST(fail_fast, never_reached) {
+    sleep_ms(3000);
+    ASSERT_TRUE(true);
+}
@@ -0,0 +1,22 @@
+// Selecting tests by pattern and by tag:
+//
+//   $ gcc examples/filters.c src/souffle.c src/hashy.c -g -lm
+//   $ ./a.out --list                            # every test with its tags
+//   $ SOUFFLE_FILTER=parser ./a.out             # the parser suite
+//   $ SOUFFLE_FILTER='lexer.number_*' ./a.out   # wildcards on suite.name
+//   $ SOUFFLE_FILTER=@slow ./a.out              # tagged slow
+//   $ SOUFFLE_FILTER=-@slow ./a.out             # everything but slow
+
+#include "../src/souffle.h"
+
+TEST(lexer, number_int) { ASSERT_EQ(1, 1); }
+
+TEST(lexer, number_float) { ASSERT_EQ(1.5, 1.5); }
+
+TEST(lexer, identifier) { ASSERT_STR_EQ("abc", "abc"); }
+
+TEST(parser, expression, .tags = "slow") { ASSERT_EQ(2 + 2, 4); }
+
+TEST(parser, statement, .tags = "slow, net") { ASSERT_EQ(3 * 3, 9); }
+
+TEST(parser, empty) { ASSERT_TRUE(true); }
@@ -0,0 +1,27 @@
+// SOUFFLE_HISTORY keeps the durations of recent runs. Later runs start the slowest tests first and,
+// after 3 runs, time a test out at 5x its slowest recent run instead of waiting for
+// SOUFFLE_TIMEOUT:
+//
+//   $ gcc examples/history.c src/souffle.c src/hashy.c -g -lm
+//   $ for i in 1 2 3; do SOUFFLE_HISTORY=history.bin ./a.out; done
+//   $ SOUFFLE_HISTORY=history.bin SLOWER=1 ./a.out   # `usually_fast` now times out after 1s
+
+#include <time.h>
+
+#include "../src/souffle.h"
+
+static void
+sleep_ms(long ms) {
+    struct timespec ts = {.tv_sec = ms / 1000, .tv_nsec = (ms % 1000) * 1000000};
+    while (nanosleep(&ts, &ts) == -1) {
+    }
+}
+
+TEST(history, quick) { ASSERT_TRUE(true); }
+
+TEST(history, medium) { sleep_ms(100); }
+
+// started first once the history knows it is the slowest.
+TEST(history, slow) { sleep_ms(400); }
+
+TEST(history, usually_fast) { sleep_ms(getenv("SLOWER") ? 5000 : 10); }
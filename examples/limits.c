@@ -0,0 +1,40 @@
+// `.max_rss_kb` and `.max_cpu_ms` fail a test that uses too much memory or CPU time. What every
+// test used is in the `usage` object of the jsonl report:
+//
+//   $ gcc examples/limits.c src/souffle.c src/hashy.c -g -lm
+//   $ ./a.out
+//   $ SOUFFLE_REPORT=jsonl:usage.jsonl ./a.out
+//
+// A test with a `.max_rss_kb` gets a process of its own in the default and server modes, so only
+// its own peak counts. Where tests share a process (SOUFFLE_MODE=batch) a test is only failed if it
+// raised the process's peak itself, never for a peak an earlier test reached. That also lets
+// `over_memory` pass there: it stays under the peak `big_without_limit` left behind.
+
+#include "../src/souffle.h"
+
+static void
+touch(size_t bytes) {
+    char *buf = malloc(bytes);
+    assert(buf);
+    memset(buf, 1, bytes);
+    DO_NOT_OPTIMIZE(buf);
+    CLOBBER_MEMORY();
+    free(buf);
+}
+
+// leaves the shared process with a high peak.
+TEST(limits, big_without_limit) { touch(200 << 20); }
+
+TEST(limits, small_under_limit, .max_rss_kb = 64 * 1024) { touch(8 << 20); }
+
+TEST(limits, over_memory, .max_rss_kb = 64 * 1024) { touch(100 << 20); }
+
+TEST(limits, over_cpu, .max_cpu_ms = 20) {
+    uint64_t x = 0;
+    for (uint64_t i = 0; i < 500000000; ++i) {
+        x += i;
+        DO_NOT_OPTIMIZE(x);
+    }
+}
+
+TEST(limits, under_cpu, .max_cpu_ms = 1000) { ASSERT_TRUE(true); }
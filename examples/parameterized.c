@@ -0,0 +1,41 @@
+// TEST_P runs its body once per row of a table. Each row is reported and filtered as a test of its
+// own, `parse_int/row_<i>`, but the rows share a child per job instead of a process each.
+//
+//   $ gcc examples/parameterized.c src/souffle.c src/hashy.c -g -lm
+//   $ ./a.out
+//   $ SOUFFLE_FILTER=parser.parse_int ./a.out   # all the rows
+
+#include "../src/souffle.h"
+
+static long
+parse_int(const char *str) {
+    return strtol(str, NULL, 10);
+}
+
+typedef struct ParseCase {
+    const char *in;
+    long out;
+} ParseCase;
+
+static const ParseCase parse_cases[] = {
+    {"0", 0},
+    {"42", 42},
+    {"-7", -7},
+    {"  12", 12},
+    {"0x10", 16}, // fails: base 10 parsing stops at the 'x'
+    {"9223372036854775807", 9223372036854775807L},
+};
+
+TEST_P(parser, parse_int, parse_cases) {
+    LOG_MSG("parsing \"%s\"\n", param->in);
+    ASSERT_EQ(parse_int(param->in), param->out);
+}
+
+static const int primes[] = {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53};
+
+TEST_P(parser, odd_primes, primes, .tags = "math") {
+    if (*param == 2) {
+        SKIP_TEST();
+    }
+    ASSERT_EQ(*param % 2, 1);
+}
@@ -0,0 +1,54 @@
+// SOUFFLE_PERF counts performance events around each test (Linux only). The two tests below do the
+// same additions, one in order and one jumping across a large buffer, so the cache misses tell
+// them apart:
+//
+//   $ gcc examples/perf.c src/souffle.c src/hashy.c -g -O2 -lm
+//   $ SOUFFLE_PERF=instructions,cycles,cache-misses,branch-misses ./a.out
+//   $ SOUFFLE_PERF=task-clock,page-faults,context-switches ./a.out   # software events
+//
+// Without access to the hardware counters (most VMs and containers, or a high
+// perf_event_paranoid) the run falls back to software events and says so on stderr.
+
+#include "../src/souffle.h"
+
+#define LEN ((size_t)1 << 24)
+#define STRIDE 4099
+
+static uint32_t *
+make_buffer() {
+    uint32_t *values = malloc(LEN * sizeof(uint32_t));
+    assert(values);
+    for (size_t i = 0; i < LEN; ++i) {
+        values[i] = (uint32_t)i;
+    }
+    return values;
+}
+
+SETUP(access, sequential) { *ctx = make_buffer(); }
+
+TEST(access, sequential) {
+    uint32_t *values = *ctx;
+    uint64_t total = 0;
+    for (size_t i = 0; i < LEN; ++i) {
+        total += values[i];
+    }
+    DO_NOT_OPTIMIZE(total);
+}
+
+TEARDOWN(access, sequential) { free(*ctx); }
+
+SETUP(access, strided) { *ctx = make_buffer(); }
+
+// STRIDE is odd, so every element is still visited once.
+TEST(access, strided) {
+    uint32_t *values = *ctx;
+    uint64_t total = 0;
+    size_t i = 0;
+    for (size_t n = 0; n < LEN; ++n) {
+        total += values[i];
+        i = (i + STRIDE) & (LEN - 1);
+    }
+    DO_NOT_OPTIMIZE(total);
+}
+
+TEARDOWN(access, strided) { free(*ctx); }
@@ -0,0 +1,71 @@
+// PROPERTY runs its body against generated inputs. A failing input is shrunk to a minimal one
+// before it is reported, with the seed that reproduces it:
+//
+//   $ gcc examples/properties.c src/souffle.c src/hashy.c -g -lm
+//   $ ./a.out
+//   $ SOUFFLE_SEED=<seed from the report> ./a.out   # the same inputs again
+//   $ SOUFFLE_PROPERTY_RUNS=10000 ./a.out
+
+#include "../src/souffle.h"
+
+// a run-length encoder with a bug: runs longer than 255 bytes wrap around.
+static size_t
+rle_encode(const unsigned char *in, size_t len, unsigned char *out) {
+    size_t n = 0;
+    for (size_t i = 0; i < len;) {
+        size_t run = 1;
+        while (i + run < len && in[i + run] == in[i]) {
+            run++;
+        }
+        out[n++] = (unsigned char)run;
+        out[n++] = in[i];
+        i += run;
+    }
+    return n;
+}
+
+static size_t
+rle_decode(const unsigned char *in, size_t len, unsigned char *out) {
+    size_t n = 0;
+    for (size_t i = 0; i + 1 < len; i += 2) {
+        memset(out + n, in[i + 1], in[i]);
+        n += in[i];
+    }
+    return n;
+}
+
+PROPERTY(rle, round_trip) {
+    size_t len;
+    const unsigned char *in = GEN_BYTES(&len, 0, 64);
+    unsigned char encoded[128];
+    unsigned char decoded[64];
+    size_t encoded_len = rle_encode(in, len, encoded);
+    size_t decoded_len = rle_decode(encoded, encoded_len, decoded);
+    ASSERT_SPAN_EQ(in, len, decoded, decoded_len);
+}
+
+// long runs of one byte: this one finds the bug, and shrinks it to 256 equal bytes.
+PROPERTY(rle, long_runs) {
+    int64_t len = GEN_INT(0, 1000);
+    int64_t byte = GEN_INT(0, 255);
+    unsigned char *in = malloc(len + 1);
+    unsigned char *encoded = malloc(2 * len + 2);
+    unsigned char *decoded = malloc(len + 1);
+    assert(in && encoded && decoded);
+    memset(in, (int)byte, len);
+    size_t decoded_len = rle_decode(encoded, rle_encode(in, len, encoded), decoded);
+    EXPECT_EQ(decoded_len, (size_t)len);
+    free(in);
+    free(encoded);
+    free(decoded);
+}
+
+// SKIP_TEST discards an input.
+PROPERTY(arith, division) {
+    int64_t a = GEN_INT(-1000, 1000);
+    int64_t b = GEN_INT(-10, 10);
+    if (b == 0) {
+        SKIP_TEST();
+    }
+    ASSERT_EQ(a / b * b + a % b, a);
+}
@@ -0,0 +1,18 @@
+// Tests are static descriptors in the `souffle_tests` linker section on ELF targets: defining
+// them runs nothing at startup, and the runner sorts them once. Suites run in name order and the
+// tests of a suite in source order, wherever they are defined:
+//
+//   $ gcc examples/registration.c src/souffle.c src/hashy.c -g -lm && ./a.out
+//   $ gcc examples/registration.c src/souffle.c src/hashy.c -g -lm -DSOUFFLE_NO_SECTIONS && ./a.out
+//
+// Both builds run apple.first, apple.second, zebra.first and zebra.second, in this order.
+
+#include "../src/souffle.h"
+
+TEST(zebra, first) { ASSERT_EQ(1, 1); }
+
+TEST(apple, first) { ASSERT_EQ(1, 1); }
+
+TEST(zebra, second) { ASSERT_EQ(2, 2); }
+
+TEST(apple, second) { ASSERT_EQ(2, 2); }
@@ -0,0 +1,70 @@
+// Results can go to files next to the console, and to reporters of the program's own:
+//
+//   $ gcc examples/reporters.c src/souffle.c src/hashy.c -g -lm
+//   $ SOUFFLE_REPORT=junit:report.xml,tap:report.tap,jsonl:report.jsonl ./a.out
+//
+// The reporter below prints a one line summary per suite to stderr.
+
+#include "../src/souffle.h"
+
+typedef struct SuiteTally {
+    const char *suite;
+    int passed;
+    int failed;
+    long elapsed_ms;
+} SuiteTally;
+
+static void
+tally_print(const SuiteTally *tally) {
+    if (tally->suite) {
+        fprintf(stderr, "[tally] %s: %d passed, %d failed, %ldms\n", tally->suite, tally->passed,
+                tally->failed, tally->elapsed_ms);
+    }
+}
+
+static void
+on_suite_start(void *data, const char *suite) {
+    SuiteTally *tally = data;
+    tally_print(tally);
+    *tally = (SuiteTally){.suite = suite};
+}
+
+static void
+on_test_end(void *data, const TestResult *result) {
+    SuiteTally *tally = data;
+    if (result->status == Success) {
+        tally->passed++;
+    } else if (result->status != Skip) {
+        tally->failed++;
+    }
+    tally->elapsed_ms += result->elapsed_ms;
+}
+
+static void
+on_run_end(void *data, [[maybe_unused]] const RunSummary *summary) {
+    tally_print(data);
+}
+
+__attribute__((constructor)) static void
+add_reporter() {
+    static SuiteTally tally;
+    register_reporter((TestReporter){
+        .on_suite_start = on_suite_start,
+        .on_test_end = on_test_end,
+        .on_run_end = on_run_end,
+        .data = &tally,
+    });
+}
+
+TEST(codec, encode) { ASSERT_STR_EQ("a%20b", "a%20b"); }
+
+TEST(codec, decode) { ASSERT_STR_EQ("a b", "a+b"); }
+
+TEST(codec, skipped) { SKIP_TEST(); }
+
+TEST(storage, open) { ASSERT_TRUE(true); }
+
+TEST(storage, close) {
+    LOG_MSG("closing <file> & \"friends\"\n");
+    ASSERT_TRUE(true);
+}
@@ -0,0 +1,29 @@
+// SOUFFLE_RERUN reuses the outcomes recorded in SOUFFLE_HISTORY. With `only-failed`, the tests
+// that passed last time in this very binary are reported as cached instead of run again:
+//
+//   $ gcc examples/rerun.c src/souffle.c src/hashy.c -g -lm
+//   $ SOUFFLE_HISTORY=history.bin ./a.out                           # `fixed_later` fails
+//   $ FIXED=1 SOUFFLE_HISTORY=history.bin SOUFFLE_RERUN=only-failed ./a.out
+//
+// The second run only runs `fixed_later`. With `failed-first` everything runs, last run's
+// failures first. A rebuild that changes the binary runs everything again.
+
+#include <time.h>
+
+#include "../src/souffle.h"
+
+static void
+sleep_ms(long ms) {
+    struct timespec ts = {.tv_sec = ms / 1000, .tv_nsec = (ms % 1000) * 1000000};
+    while (nanosleep(&ts, &ts) == -1) {
+    }
+}
+
+TEST(rerun, expensive) {
+    sleep_ms(500);
+    ASSERT_TRUE(true);
+}
+
+TEST(rerun, cheap) { ASSERT_EQ(1, 1); }
+
+TEST(rerun, fixed_later) { ASSERT_NOT_NULL(getenv("FIXED")); }
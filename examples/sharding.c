@@ -0,0 +1,29 @@
+// Splitting a run across machines. Each shard runs a disjoint, contiguous slice of the tests sorted
+// by suite.name, the same on every machine:
+//
+//   $ gcc examples/sharding.c src/souffle.c src/hashy.c -g -lm
+//   $ SOUFFLE_SHARD_INDEX=0 SOUFFLE_SHARD_COUNT=3 ./a.out
+//   $ SOUFFLE_SHARD_INDEX=1 SOUFFLE_SHARD_COUNT=3 ./a.out
+//   $ SOUFFLE_SHARD_INDEX=2 SOUFFLE_SHARD_COUNT=3 ./a.out
+//
+// Sharding applies after SOUFFLE_FILTER, and SOUFFLE_LIST=1 shows what a shard would run.
+
+#include "../src/souffle.h"
+
+TEST(alpha, one) { ASSERT_EQ(1, 1); }
+
+TEST(alpha, two) { ASSERT_EQ(2, 2); }
+
+TEST(alpha, three) { ASSERT_EQ(3, 3); }
+
+TEST(beta, one) { ASSERT_EQ(1, 1); }
+
+TEST(beta, two) { ASSERT_EQ(2, 2); }
+
+TEST(gamma, one) { ASSERT_EQ(1, 1); }
+
+TEST(gamma, two) { ASSERT_EQ(2, 2); }
+
+TEST(gamma, three) { ASSERT_EQ(3, 3); }
+
+TEST(gamma, four) { ASSERT_EQ(4, 4); }
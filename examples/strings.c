@@ -0,0 +1,37 @@
+// A string assertion reports where two strings first differ, by byte, line and column, and shows
+// 32 bytes on each side of it instead of the whole strings. SOUFFLE_DIFF_LINES adds a line diff:
+//
+//   $ gcc examples/strings.c src/souffle.c src/hashy.c -g -lm
+//   $ ./a.out
+//   $ SOUFFLE_DIFF_LINES=3 ./a.out
+
+#include "../src/souffle.h"
+
+static char *
+render_report(int errors) {
+    char *out = malloc(4096);
+    assert(out);
+    size_t len = 0;
+    for (int line = 1; line <= 40; ++line) {
+        len += snprintf(out + len, 4096 - len, "line %d: %s\n", line,
+                        line == 27 && errors ? "1 error" : "ok");
+    }
+    return out;
+}
+
+TEST(strings, long_report) {
+    char *expected = render_report(0);
+    char *actual = render_report(1);
+    ASSERT_STR_EQ(expected, actual);
+    free(expected);
+    free(actual);
+}
+
+// spans may hold NUL and control bytes, which are escaped in the report.
+TEST(strings, binary_span) {
+    const char expected[] = {'a', '\0', 'b', '\t', 'c'};
+    const char actual[] = {'a', '\0', 'b', '\n', 'c'};
+    ASSERT_SPAN_EQ(expected, sizeof(expected), actual, sizeof(actual));
+}
+
+TEST(strings, short_strings) { ASSERT_STR_EQ("hello, world", "hello, World"); }
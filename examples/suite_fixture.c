@@ -0,0 +1,66 @@
+// SUITE_SETUP builds an expensive fixture once; every test of the suite is forked from the process
+// holding it and reads it through copy-on-write pages.
+//
+//   $ gcc examples/suite_fixture.c src/souffle.c src/hashy.c -g -lm && ./a.out
+
+#include "../src/souffle.h"
+
+#define TABLE_SIZE (1 << 20)
+
+typedef struct Squares {
+    size_t len;
+    uint64_t *values;
+} Squares;
+
+SUITE_SETUP(squares) {
+    Squares *squares = malloc(sizeof(Squares));
+    assert(squares);
+    squares->len = TABLE_SIZE;
+    squares->values = malloc(TABLE_SIZE * sizeof(uint64_t));
+    assert(squares->values);
+    for (size_t i = 0; i < TABLE_SIZE; ++i) {
+        squares->values[i] = (uint64_t)i * i;
+    }
+    *ctx = squares;
+}
+
+SUITE_TEARDOWN(squares) {
+    Squares *squares = *ctx;
+    free(squares->values);
+    free(squares);
+}
+
+TEST(squares, first) {
+    Squares *squares = *ctx;
+    ASSERT_EQ(squares->values[0], 0);
+    ASSERT_EQ(squares->values[3], 9);
+}
+
+// writes to the fixture only touch this test's copy of the page (except in SOUFFLE_MODE=batch,
+// where the tests of a suite share one process and its fixture).
+TEST(squares, overwrite) {
+    Squares *squares = *ctx;
+    squares->values[12] = 0;
+    ASSERT_EQ(squares->values[12], 0);
+}
+
+TEST(squares, untouched) {
+    Squares *squares = *ctx;
+    ASSERT_EQ(squares->values[12], 144);
+}
+
+TEST(squares, last) {
+    Squares *squares = *ctx;
+    ASSERT_EQ(squares->values[squares->len - 1], (uint64_t)(TABLE_SIZE - 1) * (TABLE_SIZE - 1));
+}
+
+// a test's own SETUP starts from the suite context and may replace it.
+SETUP(squares, window) {
+    Squares *squares = *ctx;
+    *ctx = squares->values + 100;
+}
+
+TEST(squares, window) {
+    uint64_t *window = *ctx;
+    ASSERT_EQ(window[0], 10000);
+}
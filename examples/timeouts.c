@@ -0,0 +1,36 @@
+// The runner times every test out on its own clock: SIGTERM at the deadline, SIGKILL 100ms later
+// if the test is still there. `.timeout_ms` overrides SOUFFLE_TIMEOUT for one test.
+//
+//   $ gcc examples/timeouts.c src/souffle.c src/hashy.c -g -lm && SOUFFLE_TIMEOUT=500ms ./a.out
+
+#include <signal.h>
+#include <time.h>
+
+#include "../src/souffle.h"
+
+static void
+sleep_ms(long ms) {
+    struct timespec ts = {.tv_sec = ms / 1000, .tv_nsec = (ms % 1000) * 1000000};
+    while (nanosleep(&ts, &ts) == -1) {
+    }
+}
+
+TEST(timeouts, in_time, .timeout_ms = 200) {
+    sleep_ms(50);
+    ASSERT_TRUE(true);
+}
+
+TEST(timeouts, too_slow, .timeout_ms = 50) { sleep_ms(1000); }
+
+// SIGTERM is ignored, so the runner has to follow up with SIGKILL.
+TEST(timeouts, ignores_sigterm, .timeout_ms = 50) {
+    signal(SIGTERM, SIG_IGN);
+    for (;;) {
+        sleep_ms(1000);
+    }
+}
+
+// no option: SOUFFLE_TIMEOUT applies.
+TEST(timeouts, default_timeout) { sleep_ms(2000); }
+
+TEST(timeouts, after) { ASSERT_EQ(1, 1); }
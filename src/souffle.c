@@ -1,8 +1,21 @@
 #ifndef _WIN32
 #define _XOPEN_SOURCE 700
 #define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#ifdef __linux__
+#include <link.h>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+#include <poll.h>
 #include <signal.h>
+#include <stdatomic.h>
 #include <sys/ioctl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
 #include <sys/wait.h>
 #include <unistd.h>
 #else
@@ -11,9 +24,14 @@
 #define EXCEPT __except (EXCEPTION_EXECUTE_HANDLER)
 #endif // _WIN32
 
+#include <math.h>
 #include <stdarg.h>
 #include <stddef.h>
 #include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC
+#endif
 #include "hashy.h"
 #include "souffle.h"
 
@@ -56,70 +74,48 @@ string_free(SouffleString *str) {
     free(str);
 }
 
-static inline void
-string_rewind(SouffleString *str) {
-    str->len = 0;
-    str->buf[0] = '\0';
-}
-
-// dump a string to stdout and rewind
-static inline void
-string_dump(SouffleString *str) {
-    fprintf(stdout, "%s", str->buf);
-    fflush(stdout);
-    string_rewind(str);
+// Test logs are handed over whole once the test is done, so they grow to fit. Most messages fit in
+// the space left and are formatted once; only a message that doesn't is formatted again.
+static void
+string_grow_va(SouffleString *str, const char *fmt, va_list args) {
+    va_list args_copy;
+    va_copy(args_copy, args);
+    size_t size_needed = vsnprintf(str->buf + str->len, str->capacity - str->len, fmt, args);
+    if (size_needed + 1 > str->capacity - str->len) {
+        while (size_needed + 1 > str->capacity - str->len) {
+            str->capacity *= 2;
+        }
+        str->buf = realloc(str->buf, str->capacity);
+        assert(str->buf);
+        vsnprintf(str->buf + str->len, str->capacity - str->len, fmt, args_copy);
+    }
+    str->len += size_needed;
+    va_end(args_copy);
 }
 
-void
-string_append(SouffleString *str, const char *fmt, ...) {
+static void
+string_grow(SouffleString *str, const char *fmt, ...) {
     va_list args;
     va_start(args, fmt);
-    size_t size_needed = vsnprintf(NULL, 0, fmt, args);
-    va_end(args);
-
-    va_start(args, fmt);
-    if (size_needed + 1 > str->capacity) {
-        string_dump(str);
-        free(str->buf);
-        str->capacity *= 2;
-        str->buf = malloc(str->capacity * sizeof(char));
-        assert(str->buf);
-    } else if (size_needed + 1 > str->capacity - str->len) {
-        string_dump(str);
-    }
-    str->len += vsnprintf(str->buf + str->len, str->capacity, fmt, args);
-    // Cleanup
+    string_grow_va(str, fmt, args);
     va_end(args);
 }
 
 static void
-string_append_va(SouffleString *str, const char *fmt, va_list args) {
-    va_list args_copy;
-    va_copy(args_copy, args);
-    size_t size_needed = vsnprintf(NULL, 0, fmt, args);
-    if (size_needed + 1 > str->capacity) {
-        string_dump(str);
-        free(str->buf);
-        str->capacity *= 2;
-        str->buf = malloc(str->capacity * sizeof(char));
-        assert(str->buf);
-    } else if (size_needed + 1 > str->capacity - str->len) {
-        string_dump(str);
+log_msg_va(StatusInfo *status_info, const char *file, int lineno, const char *fmt, va_list args) {
+    if (status_info->msg == NULL) {
+        status_info->msg = string_init();
     }
-    str->len += vsnprintf(str->buf + str->len, str->capacity, fmt, args_copy);
-    va_end(args_copy);
+    string_grow(status_info->msg, "\t  > [" UNDERLINED "%s:%d" RESET "]:", file, lineno);
+    string_grow(status_info->msg, "\n\t  >> ");
+    string_grow_va(status_info->msg, fmt, args);
 }
 
 void
 souffle_log_msg(StatusInfo *status_info, const char *file, int lineno, const char *fmt, ...) {
-    if (status_info->msg == NULL) {
-        status_info->msg = string_init();
-    }
-    string_append(status_info->msg, "\t  > [" UNDERLINED "%s:%d" RESET "]:", file, lineno);
-    string_append(status_info->msg, "\n\t  >> ");
     va_list args;
     va_start(args, fmt);
-    string_append_va(status_info->msg, fmt, args);
+    log_msg_va(status_info, file, lineno, fmt, args);
     va_end(args);
 }
 
@@ -127,436 +123,4663 @@ void
 souffle_log_msg_raw(StatusInfo *status_info, const char *fmt, ...) {
     if (status_info->msg == NULL) {
         status_info->msg = string_init();
-        string_append(status_info->msg, "\t  ");
+        string_grow(status_info->msg, "\t  ");
     }
     if (status_info->msg->buf[status_info->msg->len - 1] == '\n') {
-        string_append(status_info->msg, "\t  ");
+        string_grow(status_info->msg, "\t  ");
     }
     va_list args;
     va_start(args, fmt);
-    string_append_va(status_info->msg, fmt, args);
+    string_grow_va(status_info->msg, fmt, args);
     va_end(args);
 }
 
-HashTable *test_suites;
-
-static size_t tcount = 0;
-static int largest_name = 0;
+// Failures logged per test: past that, a runaway loop of EXPECT_* only counts them.
+#define MAX_LOGGED_FAILURES 100
 
-static TestsVec *
-test_vec_init() {
-    TestsVec *tv = malloc(sizeof(TestsVec));
-    assert(tv);
-    tv->tests = malloc(128 * sizeof(Test));
-    tv->capacity = 128;
-    tv->len = 0;
-    return tv;
+// Marks the test failed. False once it has logged MAX_LOGGED_FAILURES failures.
+static bool
+failure_begin(StatusInfo *status_info) {
+    status_info->status = Fail;
+    return ++status_info->failures <= MAX_LOGGED_FAILURES;
 }
 
+// After the test: a SKIP_TEST() past a failed expectation does not hide it.
 static void
-test_vec_free(TestsVec *tv) {
-    free(tv->tests);
-    free(tv);
+failures_conclude(StatusInfo *status_info) {
+    if (status_info->failures == 0 || status_info->status == Crashed) {
+        return;
+    }
+    status_info->status = Fail;
+    if (status_info->failures > MAX_LOGGED_FAILURES) {
+        souffle_log_msg_raw(status_info, "... %zu more failures not shown\n",
+                            status_info->failures - MAX_LOGGED_FAILURES);
+    }
 }
 
-static void
-test_vec_push(TestsVec *tv, Test t) {
-    if (tv->len == tv->capacity) {
-        tv->tests = realloc(tv->tests, (size_t)(tv->capacity * 2) * sizeof(Test));
-        assert(tv->tests);
-        tv->capacity *= 2;
+// The failing side of every assertion, kept apart so that the checks stay a compare and a return.
+__attribute__((cold, noinline)) static bool
+assert_failed(StatusInfo *status_info, const char *file, int lineno, const char *fmt, ...)
+    PRINTF(4);
+
+__attribute__((cold, noinline)) static bool
+assert_failed(StatusInfo *status_info, const char *file, int lineno, const char *fmt, ...) {
+    if (!failure_begin(status_info)) {
+        return false;
     }
-    tv->tests[tv->len] = t;
-    tv->len++;
-    return;
+    va_list args;
+    va_start(args, fmt);
+    log_msg_va(status_info, file, lineno, fmt, args);
+    va_end(args);
+    return false;
 }
 
-void
-register_test(const char *suite, const char *name, TestFunc func, SetupFunc setup,
-              TeardownFunc teardown) {
-    if (test_suites == NULL) {
-        test_suites = hashy_init();
+// An unordered pair (a NaN) is neither less, equal nor greater, so only != holds for it.
+static inline bool
+cmp_holds(SouffleCmp cmp, bool less, bool equal, bool greater) {
+    switch (cmp) {
+    case SouffleEq:
+        return equal;
+    case SouffleNe:
+        return !equal;
+    case SouffleLt:
+        return less;
+    case SouffleLe:
+        return less || equal;
+    case SouffleGt:
+        return greater;
+    case SouffleGe:
+        return greater || equal;
     }
-    assert(test_suites);
-    void *tv = hashy_get(test_suites, suite);
-    int test_name_len = strlen(name);
-    if (test_name_len > largest_name) {
-        largest_name = test_name_len;
+    __builtin_unreachable();
+}
+
+bool
+souffle_cmp_int(StatusInfo *status_info, const char *file, int lineno, intmax_t a, intmax_t b,
+                SouffleCmp cmp) {
+    if (cmp_holds(cmp, a < b, a == b, a > b)) {
+        return true;
     }
-    int suite_name_len = strlen(suite);
-    if (suite_name_len > largest_name) {
-        largest_name = suite_name_len;
+    return assert_failed(status_info, file, lineno, "Left:  \"%jd\"\n\t  >> Right: \"%jd\"\n", a,
+                         b);
+}
+
+bool
+souffle_cmp_uint(StatusInfo *status_info, const char *file, int lineno, uintmax_t a, uintmax_t b,
+                 SouffleCmp cmp) {
+    if (cmp_holds(cmp, a < b, a == b, a > b)) {
+        return true;
     }
-    Test t = {
-        .func = func,
-        .name = name,
-        .setup = setup,
-        .teardown = teardown,
-    };
-    if (tv == NULL) {
-        tv = test_vec_init();
-        test_vec_push(tv, t);
-        hashy_insert(test_suites, suite, tv);
-        tcount += 1;
-        return;
+    return assert_failed(status_info, file, lineno, "Left:  \"%ju\"\n\t  >> Right: \"%ju\"\n", a,
+                         b);
+}
+
+bool
+souffle_cmp_double(StatusInfo *status_info, const char *file, int lineno, double a, double b,
+                   SouffleCmp cmp) {
+    if (cmp_holds(cmp, a < b, a == b, a > b)) {
+        return true;
     }
-    test_vec_push(tv, t);
-    tcount += 1;
-    return;
+    return assert_failed(status_info, file, lineno, "Left:  \"%f\"\n\t  >> Right: \"%f\"\n", a, b);
 }
 
-#ifndef _WIN32
-void
-timeout_handler(int signo) {
-    (void)signo;
-    exit(Timeout);
+bool
+souffle_cmp_long_double(StatusInfo *status_info, const char *file, int lineno, long double a,
+                        long double b, SouffleCmp cmp) {
+    if (cmp_holds(cmp, a < b, a == b, a > b)) {
+        return true;
+    }
+    return assert_failed(status_info, file, lineno, "Left:  \"%Lf\"\n\t  >> Right: \"%Lf\"\n", a,
+                         b);
 }
 
-void
-alarm_setup() {
-    struct sigaction sa;
-    sa.sa_handler = timeout_handler;
-    sigemptyset(&sa.sa_mask);
-    sa.sa_flags = 0;
-    sigaction(SIGALRM, &sa, NULL);
+bool
+souffle_cmp_ptr(StatusInfo *status_info, const char *file, int lineno, const void *a,
+                const void *b, SouffleCmp cmp) {
+    if (cmp_holds(cmp, a < b, a == b, a > b)) {
+        return true;
+    }
+    return assert_failed(status_info, file, lineno, "Left:  \"%p\"\n\t  >> Right: \"%p\"\n", a, b);
 }
 
-int
-run_all_tests() {
-    const char *timeout_str = getenv("SOUFFLE_TIMEOUT");
-    volatile int timeout_time = timeout_str ? atoi(timeout_str) : 20;
-    if (timeout_time == 0) {
-        timeout_time = 20;
+// Strings up to this long are shown whole when they differ, longer ones as an excerpt of this many
+// bytes on each side of the first difference.
+#define STR_SHOWN_WHOLE 80
+#define STR_CONTEXT 32
+// Longest line shown in a line diff (SOUFFLE_DIFF_LINES), and the most lines it compares.
+#define DIFF_LINE_WIDTH 120
+#define DIFF_MAX_LINES 1000
+
+// SOUFFLE_DIFF_LINES: add a line diff of up to that many lines to a string assertion failure,
+// starting at the line of the first difference. 0 (the default) leaves it out.
+static size_t
+diff_lines() {
+    const char *lines_str = getenv("SOUFFLE_DIFF_LINES");
+    long lines = lines_str ? atol(lines_str) : 0;
+    return lines > 0 ? (size_t)lines : 0;
+}
+
+// Offset of the first byte where a and b differ, or len: memcmp finds the block, words the byte.
+static size_t
+first_difference(const char *a, const char *b, size_t len) {
+    enum { BLOCK = 4096 };
+    size_t i = 0;
+    while (len - i > BLOCK && memcmp(a + i, b + i, BLOCK) == 0) {
+        i += BLOCK;
     }
-    // Setup Printing End Column
-    struct winsize w;
-    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &w) == -1) {
-        w.ws_col = 80;
+    for (; len - i >= sizeof(uint64_t); i += sizeof(uint64_t)) {
+        uint64_t wa, wb;
+        memcpy(&wa, a + i, sizeof(wa));
+        memcpy(&wb, b + i, sizeof(wb));
+        if (wa != wb) {
+            break;
+        }
     }
-    int cols = w.ws_col;
-    int max_cols = cols > 53 ? 53 : cols;
-    max_cols =
-        largest_name < max_cols ? max_cols : (largest_name > cols - 4 ? cols - 4 : largest_name);
+    while (i < len && a[i] == b[i]) {
+        i++;
+    }
+    return i;
+}
 
-    SouffleString *output = string_init();
+// Appends s[0, len) to the log with control characters, quotes and backslashes escaped.
+static void
+log_escaped(StatusInfo *status_info, const char *s, size_t len) {
+    char buf[256];
+    size_t used = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (used > sizeof(buf) - 5) {
+            souffle_log_msg_raw(status_info, "%.*s", (int)used, buf);
+            used = 0;
+        }
+        unsigned char c = s[i];
+        const char *esc = c == '\n' ? "\\n" : c == '\t' ? "\\t" : c == '"' ? "\\\"" : NULL;
+        esc = c == '\\' ? "\\\\" : esc;
+        if (esc) {
+            used += snprintf(buf + used, sizeof(buf) - used, "%s", esc);
+        } else if (c < 0x20 || c == 0x7f) {
+            used += snprintf(buf + used, sizeof(buf) - used, "\\x%02x", c);
+        } else {
+            buf[used++] = c;
+        }
+    }
+    souffle_log_msg_raw(status_info, "%.*s", (int)used, buf);
+}
 
-    assert(test_suites);
-    int scount = test_suites->size;
+// `s` around `offset`: the whole string when it is short.
+static void
+log_excerpt(StatusInfo *status_info, const char *s, size_t len, size_t offset) {
+    size_t from = 0;
+    size_t to = len;
+    if (len > STR_SHOWN_WHOLE) {
+        from = offset > STR_CONTEXT ? offset - STR_CONTEXT : 0;
+        to = len - offset > STR_CONTEXT ? offset + STR_CONTEXT : len;
+    }
+    souffle_log_msg_raw(status_info, "%s\"", from > 0 ? "..." : "");
+    log_escaped(status_info, s + from, to - from);
+    souffle_log_msg_raw(status_info, "\"%s", to < len ? "..." : "");
+    if (len > STR_SHOWN_WHOLE) {
+        souffle_log_msg_raw(status_info, " (%zu bytes)", len);
+    }
+}
 
-    // Result Header
-    string_append(output, "=== Test Run Started ===\n");
-    string_append(output, "%.*s\n\n", max_cols, DASHES);
-    string_append(output, "Running %zu tests in %d suites\n", tcount, scount);
-    string_append(output, "%.*s\n\n", max_cols, DASHES);
+typedef struct Line {
+    const char *s;
+    size_t len;
+} Line;
 
-    int passed = 0;
-    int failed = 0;
-    int crashed = 0;
-    int skipped = 0;
-    int timeout = 0;
-    struct HashTableIterator iterator = hashy_iter(test_suites);
-    while (true) {
-        TestsVec *tv = NULL;
-        const char *suite_name = hashy_next(&iterator, (void **)&tv);
-        if (suite_name == NULL || tv == NULL)
-            break;
-        int spaces_required = max_cols - 11 - strlen(suite_name);
-        if (spaces_required < 0)
-            spaces_required = 0;
-        string_append(output, "⣿ Suite: %.*s %*s⣿\n", max_cols - 11, suite_name, spaces_required,
-                      "");
-        for (volatile size_t idx = 0; idx < tv->len; ++idx) {
-            int padding = max_cols - strlen(tv->tests[idx].name) - 28;
-            string_append(output, "  %s 🧪 %.*s ......", tv->tests[idx].setup ? "⚙" : " ",
-                          max_cols - 28, tv->tests[idx].name);
-
-            for (int i = 0; i < padding; ++i) {
-                string_append(output, ".");
-            }
-            // setup pipes for transmitting fail info.
-            int pipefd[2];
-            if (pipe(pipefd) == -1) {
-                perror("Pipe failed");
-                exit(EXIT_FAILURE);
-            }
-            struct timespec start, end;
-            timespec_get(&start, TIME_UTC);
-            pid_t pid = vfork();
-            if (pid == 0) {
-                // child process
-                close(pipefd[0]);
-                alarm_setup();
-                StatusInfo tstatus = {
-                    .status = Success,
-                    .msg = NULL,
-                };
-                alarm(timeout_time);
-                void *ctx_internl = NULL;
-                void **ctx = &ctx_internl;
-                if (tv->tests[idx].setup) {
-                    tv->tests[idx].setup(ctx);
-                }
-                tv->tests[idx].func(&tstatus, ctx);
-                if (tv->tests[idx].teardown) {
-                    tv->tests[idx].teardown(ctx);
-                }
-                if (tstatus.msg) {
-                    int wret = write(pipefd[1], &tstatus.msg->len, sizeof(int));
-                    wret |= write(pipefd[1], tstatus.msg->buf, tstatus.msg->len);
-                    if (wret == -1) {
-                        perror("Failed to write to pipe");
-                    }
-                    string_free(tstatus.msg);
-                }
+// Splits s[from, len) into at most `max` lines.
+static size_t
+split_lines(const char *s, size_t len, size_t from, Line *lines, size_t max) {
+    size_t count = 0;
+    while (from < len && count < max) {
+        const char *nl = memchr(s + from, '\n', len - from);
+        size_t end = nl ? (size_t)(nl - s) : len;
+        lines[count++] = (Line){.s = s + from, .len = end - from};
+        from = end + 1;
+    }
+    return count;
+}
 
-                close(pipefd[1]);
+static bool
+line_eq(Line a, Line b) {
+    return a.len == b.len && memcmp(a.s, b.s, a.len) == 0;
+}
+
+static void
+log_diff_line(StatusInfo *status_info, char mark, Line line) {
+    souffle_log_msg_raw(status_info, "  %c ", mark);
+    log_escaped(status_info, line.s, line.len < DIFF_LINE_WIDTH ? line.len : DIFF_LINE_WIDTH);
+    souffle_log_msg_raw(status_info, "%s\n", line.len > DIFF_LINE_WIDTH ? "..." : "");
+}
 
-                exit(tstatus.status);
+// A line diff ("-" left, "+" right) from the line at `from` on, through the longest common
+// subsequence of the next `max` lines of both sides.
+static void
+log_line_diff(StatusInfo *status_info, const char *a, size_t alen, const char *b, size_t blen,
+              size_t from, size_t line, size_t max) {
+    max = max < DIFF_MAX_LINES ? max : DIFF_MAX_LINES;
+    Line *la = malloc(2 * max * sizeof(Line));
+    assert(la);
+    Line *lb = la + max;
+    size_t na = split_lines(a, alen, from, la, max);
+    size_t nb = split_lines(b, blen, from, lb, max);
+    // lcs[i * (nb + 1) + j]: the common lines of la[i, na) and lb[j, nb).
+    uint32_t *lcs = calloc((na + 1) * (nb + 1), sizeof(uint32_t));
+    assert(lcs);
+    for (size_t i = na; i-- > 0;) {
+        for (size_t j = nb; j-- > 0;) {
+            uint32_t *cell = &lcs[i * (nb + 1) + j];
+            if (line_eq(la[i], lb[j])) {
+                *cell = lcs[(i + 1) * (nb + 1) + j + 1] + 1;
             } else {
-                close(pipefd[1]);
-                // parent process
-                int status;
-                waitpid(pid, &status, 0);
-                timespec_get(&end, TIME_UTC);
-                long elapsed_ms =
-                    (end.tv_sec - start.tv_sec) * 1000 + (end.tv_nsec - start.tv_nsec) / 1000000;
-                int buf_size = 0;
-                int rret = read(pipefd[0], &buf_size, sizeof(int));
-                // calloc for the null terminator
-                char *err_buf = buf_size ? calloc((buf_size + 1), sizeof(char)) : NULL;
-                rret = read(pipefd[0], err_buf, buf_size);
-                if (rret == -1) {
-                    perror("Failed to read to pipe");
-                }
-                if (WIFEXITED(status)) {
-                    switch ((enum Status)WEXITSTATUS(status)) {
-                    case Success:
-                        string_append(output, " " GREEN "[PASSED, %ldms]" RESET "\n%s\n",
-                                      elapsed_ms, err_buf ? err_buf : "");
-                        passed += 1;
-                        break;
-                    case Fail: {
-                        string_append(output, " " RED "[FAILED, %ldms]" RESET "\n%s\n", elapsed_ms,
-                                      err_buf ? err_buf : "");
-                        failed += 1;
-                        break;
-                    }
-                    case Skip:
-                        string_append(output, " " YELLOW "[SKIPPED, ⏭ ]" RESET "\n%s\n",
-                                      err_buf ? err_buf : "");
-                        skipped += 1;
-                        break;
-                    case Timeout:
-                        string_append(output, " " GREY "[TIMEOUT, ⧖ ]" RESET "\n%s\n",
-                                      err_buf ? err_buf : "");
-                        timeout += 1;
-                        break;
-                    default:
-                        unreachable();
-                    };
-                } else if (WIFSIGNALED(status)) {
-                    string_append(output, " " MAGENTA "[CRASHED, ☠ ]" RESET "\n\n");
-                    crashed += 1;
-                }
-                free(err_buf);
-                close(pipefd[0]);
+                uint32_t down = lcs[(i + 1) * (nb + 1) + j];
+                uint32_t right = lcs[i * (nb + 1) + j + 1];
+                *cell = down > right ? down : right;
             }
         }
-        test_vec_free(tv);
-    }
-
-    hashy_free(test_suites);
-    string_append(output, "%.*s\n\n", max_cols, DASHES);
-    string_append(output, "=== Test Run Summary ===\n");
-    string_append(output,
-                  "Total Tests: %zu | " GREEN "Passed" RESET ": %d | " RED "Failed" RESET
-                  ": %d | " MAGENTA "Crashed" RESET ": %d | " YELLOW "Skipped" RESET ": %d | " GREY
-                  "Timeout" RESET ": %d\n",
-                  tcount, passed, failed, crashed, skipped, timeout);
-    string_append(output, "%.*s\n", max_cols, DASHES);
-    fprintf(stdout, "%s", output->buf);
-    string_free(output);
-    if (crashed > 0 || failed > 0 || timeout > 0) {
-        return 1;
     }
-    return 0;
+    souffle_log_msg_raw(status_info, ">> Diff from line %zu:\n", line);
+    size_t i = 0, j = 0;
+    for (size_t shown = 0; shown < max && (i < na || j < nb); shown++) {
+        bool left_first = j == nb || (i < na && lcs[(i + 1) * (nb + 1) + j] >=
+                                                    lcs[i * (nb + 1) + j + 1]);
+        if (i < na && j < nb && line_eq(la[i], lb[j])) {
+            log_diff_line(status_info, ' ', la[i++]);
+            j++;
+        } else if (left_first) {
+            log_diff_line(status_info, '-', la[i++]);
+        } else {
+            log_diff_line(status_info, '+', lb[j++]);
+        }
+    }
+    free(lcs);
+    free(la);
 }
-#else
-// Windows
 
-typedef struct ThreadInfo {
-    Test *test;
-    StatusInfo *status_info;
-} ThreadInfo;
+// Reports where two byte strings part: byte offset, line and column, an excerpt of each and,
+// with SOUFFLE_DIFF_LINES, a line diff.
+__attribute__((cold, noinline)) static bool
+span_failed(StatusInfo *status_info, const char *file, int lineno, const char *a, size_t alen,
+            const char *b, size_t blen) {
+    if (!failure_begin(status_info)) {
+        return false;
+    }
+    size_t offset = first_difference(a, b, alen < blen ? alen : blen);
+    size_t line = 1;
+    size_t line_start = 0;
+    for (const char *nl = a; (nl = memchr(nl, '\n', a + offset - nl)) != NULL; nl++) {
+        line++;
+        line_start = nl - a + 1;
+    }
+    souffle_log_msg(status_info, file, lineno, "Left:  ");
+    log_excerpt(status_info, a, alen, offset);
+    souffle_log_msg_raw(status_info, "\n\t  >> Right: ");
+    log_excerpt(status_info, b, blen, offset);
+    if (alen == blen && offset == alen) {
+        souffle_log_msg_raw(status_info, "\n");
+        return false;
+    }
+    souffle_log_msg_raw(status_info,
+                        "\n\t  >> First difference at byte %zu (line %zu, column %zu)\n", offset,
+                        line, offset - line_start + 1);
+    size_t max = diff_lines();
+    if (max > 0) {
+        log_line_diff(status_info, a, alen, b, blen, line_start, line, max);
+    }
+    return false;
+}
 
-DWORD WINAPI
-func_exec_timeout_win(LPVOID lpParam) {
-    ThreadInfo *ti = (ThreadInfo *)lpParam;
-    void *ctx_internl = NULL;
-    void **ctx = &ctx_internl;
-    TRY {
-        if (ti->test->setup) {
-            ti->test->setup(ctx);
+bool
+souffle_cmp_str(StatusInfo *status_info, const char *file, int lineno, const char *a,
+                const char *b, SouffleCmp cmp) {
+    int order = a && b ? strcmp(a, b) : (a != NULL) - (b != NULL);
+    if (cmp_holds(cmp, order < 0, order == 0, order > 0)) {
+        return true;
+    }
+    if (a == NULL || b == NULL) {
+        return assert_failed(status_info, file, lineno, "Left:  \"%s\"\n\t  >> Right: \"%s\"\n",
+                             a ? a : "(null)", b ? b : "(null)");
+    }
+    return span_failed(status_info, file, lineno, a, strlen(a), b, strlen(b));
+}
+
+bool
+souffle_cmp_span(StatusInfo *status_info, const char *file, int lineno, const void *a,
+                 size_t alen, const void *b, size_t blen, SouffleCmp cmp) {
+    bool equal = alen == blen && (alen == 0 || memcmp(a, b, alen) == 0);
+    if (equal == (cmp == SouffleEq)) {
+        return true;
+    }
+    return span_failed(status_info, file, lineno, a, alen, b, blen);
+}
+
+bool
+souffle_check_bool(StatusInfo *status_info, const char *file, int lineno, bool value,
+                   bool expected) {
+    if (value == expected) {
+        return true;
+    }
+    return assert_failed(status_info, file, lineno, "Left:  \"%s\"\n\t  >> Right: \"%s\"\n",
+                         expected ? "true" : "false", value ? "true" : "false");
+}
+
+bool
+souffle_check_null(StatusInfo *status_info, const char *file, int lineno, const void *ptr,
+                   bool expected_null) {
+    if ((ptr == NULL) == expected_null) {
+        return true;
+    }
+    if (expected_null) {
+        return assert_failed(status_info, file, lineno, "Left:  \"NULL\"\n\t  >> Right: \"%p\"\n",
+                             ptr);
+    }
+    return assert_failed(status_info, file, lineno,
+                         "Left:  \"NOT NULL\"\n\t  >> Right: \"NULL\"\n");
+}
+
+// Elements shown on each side of the first mismatch of an array assertion.
+#define ARR_CONTEXT 4
+
+typedef struct Tolerance {
+    double epsilon;
+    uint64_t ulps;
+} Tolerance;
+
+// Distance in representable values: the bits of a float, read as sign and magnitude, mapped onto
+// one ordered integer line (-0 and +0 are the same point).
+static inline uint64_t
+float_ulps(float a, float b) {
+    int32_t ia, ib;
+    memcpy(&ia, &a, sizeof(ia));
+    memcpy(&ib, &b, sizeof(ib));
+    int64_t oa = ia < 0 ? (int64_t)INT32_MIN - ia : ia;
+    int64_t ob = ib < 0 ? (int64_t)INT32_MIN - ib : ib;
+    return oa > ob ? (uint64_t)(oa - ob) : (uint64_t)(ob - oa);
+}
+
+static inline uint64_t
+double_ulps(double a, double b) {
+    int64_t ia, ib;
+    memcpy(&ia, &a, sizeof(ia));
+    memcpy(&ib, &b, sizeof(ib));
+    uint64_t oa = ia < 0 ? -(uint64_t)ia : (uint64_t)ia + (uint64_t)INT64_MIN;
+    uint64_t ob = ib < 0 ? -(uint64_t)ib : (uint64_t)ib + (uint64_t)INT64_MIN;
+    return oa > ob ? oa - ob : ob - oa;
+}
+
+// A NaN is near nothing. Long doubles are held to the tolerance as doubles.
+static inline bool
+near(double a, double b, uint64_t ulps, const Tolerance *tol) {
+    if (a != a || b != b) {
+        return false;
+    }
+    return (a > b ? a - b : b - a) <= tol->epsilon || ulps <= tol->ulps;
+}
+
+// Whether element i of a and b differs, exactly or beyond `tol` if given.
+static bool
+elem_differs(const unsigned char *a, const unsigned char *b, size_t i, size_t elem_size,
+             SouffleElem elem, const Tolerance *tol) {
+    a += i * elem_size;
+    b += i * elem_size;
+    if (elem != SouffleElemFloat) {
+        return memcmp(a, b, elem_size) != 0;
+    }
+    if (elem_size == sizeof(float)) {
+        float fa, fb;
+        memcpy(&fa, a, sizeof(fa));
+        memcpy(&fb, b, sizeof(fb));
+        return tol ? !near(fa, fb, float_ulps(fa, fb), tol) : fa != fb;
+    }
+    if (elem_size == sizeof(double)) {
+        double da, db;
+        memcpy(&da, a, sizeof(da));
+        memcpy(&db, b, sizeof(db));
+        return tol ? !near(da, db, double_ulps(da, db), tol) : da != db;
+    }
+    long double la, lb;
+    memcpy(&la, a, sizeof(la));
+    memcpy(&lb, b, sizeof(lb));
+    return tol ? !near(la, lb, double_ulps(la, lb), tol) : la != lb;
+}
+
+static void
+elem_log(StatusInfo *status_info, const unsigned char *p, size_t elem_size, SouffleElem elem) {
+    switch (elem) {
+    case SouffleElemByte:
+        souffle_log_msg_raw(status_info, "%02x", *p);
+        return;
+    case SouffleElemFloat:
+        if (elem_size == sizeof(float)) {
+            float f;
+            memcpy(&f, p, sizeof(f));
+            souffle_log_msg_raw(status_info, "%f", f);
+        } else if (elem_size == sizeof(double)) {
+            double d;
+            memcpy(&d, p, sizeof(d));
+            souffle_log_msg_raw(status_info, "%f", d);
+        } else {
+            long double ld;
+            memcpy(&ld, p, sizeof(ld));
+            souffle_log_msg_raw(status_info, "%Lf", ld);
         }
-        if (ti->test->func) {
-            ti->test->func(ti->status_info, ctx);
+        return;
+    case SouffleElemInt:
+    case SouffleElemUint:
+        break;
+    }
+    // Integers of any width: sign extend from the top byte of the element.
+    uintmax_t value = 0;
+    memcpy(&value, p, elem_size < sizeof(value) ? elem_size : sizeof(value));
+    size_t bits = elem_size * 8;
+    if (bits < sizeof(value) * 8) {
+        uintmax_t sign = (uintmax_t)1 << (bits - 1);
+        if (elem == SouffleElemInt && (value & sign)) {
+            value |= ~((sign << 1) - 1);
         }
-        if (ti->test->teardown) {
-            ti->test->teardown(ctx);
+    }
+    if (elem == SouffleElemInt) {
+        souffle_log_msg_raw(status_info, "%jd", (intmax_t)value);
+    } else {
+        souffle_log_msg_raw(status_info, "%ju", value);
+    }
+}
+
+static void
+arr_log_window(StatusInfo *status_info, const unsigned char *arr, size_t len, size_t elem_size,
+               SouffleElem elem, size_t first) {
+    size_t from = first > ARR_CONTEXT ? first - ARR_CONTEXT : 0;
+    size_t to = len - first > ARR_CONTEXT ? first + ARR_CONTEXT + 1 : len;
+    souffle_log_msg_raw(status_info, "[ %s", from > 0 ? "..., " : "");
+    for (size_t i = from; i < to; i++) {
+        if (i > from) {
+            souffle_log_msg_raw(status_info, ", ");
         }
-        return 0;
+        elem_log(status_info, arr + i * elem_size, elem_size, elem);
     }
-    EXCEPT {
-        ti->status_info->status = Crashed;
-        return 0;
+    souffle_log_msg_raw(status_info, "%s ]", to < len ? ", ..." : "");
+}
+
+__attribute__((cold, noinline)) static bool
+arr_failed(StatusInfo *status_info, const char *file, int lineno, const unsigned char *a,
+           const unsigned char *b, size_t len, size_t elem_size, SouffleElem elem,
+           const Tolerance *tol) {
+    if (!failure_begin(status_info)) {
+        return false;
     }
+    size_t first = len;
+    size_t count = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (elem_differs(a, b, i, elem_size, elem, tol)) {
+            first = count++ == 0 ? i : first;
+        }
+    }
+    assert(count > 0);
+    souffle_log_msg(status_info, file, lineno, "Left:  ");
+    arr_log_window(status_info, a, len, elem_size, elem, first);
+    souffle_log_msg_raw(status_info, "\n\t  >> Right: ");
+    arr_log_window(status_info, b, len, elem_size, elem, first);
+    souffle_log_msg_raw(status_info, "\n\t  >> %zu of %zu %s differ, first at [%zu]\n", count,
+                        len, elem == SouffleElemByte ? "bytes" : "elements", first);
+    return false;
 }
 
-int
-run_all_tests_win() {
-    const char *var_name = "SOUFFLE_TIMEOUT";
-    size_t required_size;
-    DWORD timeout_time = 20000;
-    getenv_s(&required_size, NULL, 0, var_name);
-    if (required_size != 0) {
-        char env_value[required_size];
-        getenv_s(&required_size, env_value, required_size, var_name);
-        errno = 0;
-        char *endptr;
-        unsigned long ret = strtoul(env_value, &endptr, 10);
-        if (endptr != env_value && errno == 0) {
-            timeout_time = ret * 1000;
+// The passing path: loops over the actual element type, which the compiler vectorizes.
+static size_t
+count_different_float(const float *a, const float *b, size_t len) {
+    size_t count = 0;
+    for (size_t i = 0; i < len; i++) {
+        count += a[i] != b[i];
+    }
+    return count;
+}
+
+static size_t
+count_different_double(const double *a, const double *b, size_t len) {
+    size_t count = 0;
+    for (size_t i = 0; i < len; i++) {
+        count += a[i] != b[i];
+    }
+    return count;
+}
+
+static size_t
+count_different_long_double(const long double *a, const long double *b, size_t len) {
+    size_t count = 0;
+    for (size_t i = 0; i < len; i++) {
+        count += a[i] != b[i];
+    }
+    return count;
+}
+
+bool
+souffle_cmp_arr(StatusInfo *status_info, const char *file, int lineno, const void *a,
+                const void *b, size_t len, size_t elem_size, SouffleElem elem) {
+    bool equal;
+    if (elem != SouffleElemFloat) {
+        equal = len == 0 || memcmp(a, b, len * elem_size) == 0;
+    } else if (elem_size == sizeof(float)) {
+        equal = count_different_float(a, b, len) == 0;
+    } else if (elem_size == sizeof(double)) {
+        equal = count_different_double(a, b, len) == 0;
+    } else {
+        equal = count_different_long_double(a, b, len) == 0;
+    }
+    if (equal) {
+        return true;
+    }
+    return arr_failed(status_info, file, lineno, a, b, len, elem_size, elem, NULL);
+}
+
+bool
+souffle_cmp_arr_near(StatusInfo *status_info, const char *file, int lineno, const void *a,
+                     const void *b, size_t len, size_t elem_size, double epsilon, uint64_t ulps) {
+    Tolerance tol = {.epsilon = epsilon, .ulps = ulps};
+    size_t far = 0;
+    if (elem_size == sizeof(float)) {
+        const float *fa = a, *fb = b;
+        for (size_t i = 0; i < len; i++) {
+            far += !near(fa[i], fb[i], float_ulps(fa[i], fb[i]), &tol);
+        }
+    } else if (elem_size == sizeof(double)) {
+        const double *da = a, *db = b;
+        for (size_t i = 0; i < len; i++) {
+            far += !near(da[i], db[i], double_ulps(da[i], db[i]), &tol);
+        }
+    } else {
+        for (size_t i = 0; i < len; i++) {
+            far += elem_differs(a, b, i, elem_size, SouffleElemFloat, &tol);
         }
     }
-    // Setup Printing End Column. Since we don't have ioctl in windows we need to use windows.h
-    CONSOLE_SCREEN_BUFFER_INFO csbi;
-    GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &csbi);
-    int cols = csbi.srWindow.Right - csbi.srWindow.Left + 1;
-    int max_cols = cols > 53 ? 53 : cols;
-    max_cols =
-        largest_name < max_cols ? max_cols : (largest_name > cols - 4 ? cols - 4 : largest_name);
+    if (far == 0) {
+        return true;
+    }
+    return arr_failed(status_info, file, lineno, a, b, len, elem_size, SouffleElemFloat, &tol);
+}
+
+#define FNV_OFFSET 14695981039346656037ull
+
+static uint64_t
+fnv1a(uint64_t hash, const void *data, size_t len) {
+    for (size_t i = 0; i < len; ++i) {
+        hash = (hash ^ ((const unsigned char *)data)[i]) * 1099511628211ull;
+    }
+    return hash;
+}
 
-    SouffleString *output = string_init();
+// ---------------- PROPERTIES ----------------
 
-    assert(test_suites);
-    int scount = test_suites->size;
+// Inputs tried per PROPERTY unless SOUFFLE_PROPERTY_RUNS says otherwise.
+#define PROPERTY_RUNS 1000
+// Replays a failing input may take to shrink.
+#define SHRINK_RUNS 10000
+// Elements a generated buffer or string has past its minimum length, on average.
+#define GEN_MEAN_LEN 32
+// Bytes of a generated buffer shown in the log.
+#define GEN_BYTES_SHOWN 64
 
-    string_append(output, "=== Test Run Started ===\n");
-    string_append(output, "%.*s\n\n", max_cols, DASHES);
-    string_append(output, "Running %zu tests in %d suites\n", tcount, scount);
-    string_append(output, "%.*s\n\n", max_cols, DASHES);
+// What gen_str() picks from, in the order it shrinks to.
+static const char GEN_ALPHABET[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789"
+                                   " !\"#$%&'()*+,-./:;<=>?@[\\]^_`{|}~";
 
-    int passed = 0;
-    int failed = 0;
-    int crashed = 0;
-    int skipped = 0;
-    int timeout = 0;
-    struct HashTableIterator iterator = hashy_iter(test_suites);
-    while (true) {
-        TestsVec *tv = NULL;
-        const char *suite_name = hashy_next(&iterator, (void **)&tv);
-        if (suite_name == NULL || tv == NULL) {
-            break;
+// A run of the body draws its input as a sequence of choices, each a number the generators map to
+// a value so that smaller choices make simpler values. Shrinking edits the sequence and replays
+// it.
+struct SouffleGen {
+    uint64_t rng;
+    // the choices replayed, past their end every choice is 0. NULL while searching: all random.
+    const uint64_t *source;
+    size_t source_len;
+    // the choices made by this run.
+    uint64_t *drawn;
+    size_t len;
+    size_t capacity;
+    // the buffers handed out by this run.
+    void **buffers;
+    size_t nbuffers;
+    size_t buffers_capacity;
+    // on the replay that is reported, every value drawn is logged there.
+    StatusInfo *log;
+    size_t logged;
+};
+
+// splitmix64
+static uint64_t
+gen_next(uint64_t *state) {
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+static uint64_t
+gen_record(SouffleGen *gen, uint64_t choice) {
+    if (gen->len == gen->capacity) {
+        gen->capacity = gen->capacity ? gen->capacity * 2 : 64;
+        gen->drawn = realloc(gen->drawn, gen->capacity * sizeof(uint64_t));
+        assert(gen->drawn);
+    }
+    gen->drawn[gen->len++] = choice;
+    return choice;
+}
+
+// The next choice, in [0, max]. One random choice in eight is below 16, so that the values the
+// generators shrink towards come up.
+static uint64_t
+gen_draw(SouffleGen *gen, uint64_t max) {
+    if (gen->source) {
+        uint64_t choice = gen->len < gen->source_len ? gen->source[gen->len] : 0;
+        return gen_record(gen, choice < max ? choice : max);
+    }
+    uint64_t bound = (gen_next(&gen->rng) & 7) == 0 && max > 15 ? 15 : max;
+    uint64_t r = gen_next(&gen->rng);
+    return gen_record(gen, bound == UINT64_MAX ? r : r % (bound + 1));
+}
+
+// Whether a buffer or string gets one more element: a choice of 1, and of 0 to end it one random
+// time in `mean + 1`. Deleting the choice and the element after it shrinks the collection.
+static bool
+gen_more(SouffleGen *gen, uint64_t mean) {
+    if (gen->source) {
+        return gen_draw(gen, 1);
+    }
+    return gen_record(gen, gen_next(&gen->rng) % (mean + 1) != 0);
+}
+
+// Forget the last run: its choices and buffers.
+static void
+gen_reset(SouffleGen *gen) {
+    for (size_t i = 0; i < gen->nbuffers; ++i) {
+        free(gen->buffers[i]);
+    }
+    gen->nbuffers = 0;
+    gen->len = 0;
+    gen->logged = 0;
+}
+
+static void
+gen_keep(SouffleGen *gen, void *buffer) {
+    if (gen->nbuffers == gen->buffers_capacity) {
+        gen->buffers_capacity = gen->buffers_capacity ? gen->buffers_capacity * 2 : 8;
+        gen->buffers = realloc(gen->buffers, gen->buffers_capacity * sizeof(void *));
+        assert(gen->buffers);
+    }
+    gen->buffers[gen->nbuffers++] = buffer;
+}
+
+int64_t
+souffle_gen_int(SouffleGen *gen, int64_t min, int64_t max) {
+    assert(min <= max);
+    uint64_t choice = gen_draw(gen, (uint64_t)max - (uint64_t)min);
+    int64_t value;
+    if (min >= 0) {
+        value = (int64_t)((uint64_t)min + choice);
+    } else if (max <= 0) {
+        value = (int64_t)((uint64_t)max - choice);
+    } else {
+        // 0, -1, 1, -2, 2... while both sides last, then on along the longer one.
+        uint64_t below = -(uint64_t)min;
+        uint64_t above = (uint64_t)max;
+        uint64_t shorter = below < above ? below : above;
+        if (choice / 2 <= shorter - (choice & 1)) {
+            value = (int64_t)(choice >> 1) ^ -(int64_t)(choice & 1);
+        } else if (above > below) {
+            value = (int64_t)(choice - shorter);
+        } else {
+            value = (int64_t)(0 - (choice - shorter));
         }
-        int spaces_required = max_cols - 11 - strlen(suite_name);
-        if (spaces_required < 0)
-            spaces_required = 0;
-        string_append(output, "⣿ Suite: %.*s %*s⣿\n", max_cols - 11, suite_name, spaces_required,
-                      "");
-        for (size_t idx = 0; idx < tv->len; ++idx) {
-
-            int padding = max_cols - strlen(tv->tests[idx].name) - 28;
-            string_append(output, "  %s 🧪 %.*s ......", tv->tests[idx].setup ? "⚙" : " ",
-                          max_cols - 28, tv->tests[idx].name);
-            for (int i = 0; i < padding; ++i) {
-                string_append(output, ".");
-            }
-            struct timespec start, end;
-            timespec_get(&start, TIME_UTC);
-            StatusInfo tstatus = {
-                .status = Success,
-                .msg = NULL,
-            };
-
-            ThreadInfo tinfo = {
-                .test = &tv->tests[idx],
-                .status_info = &tstatus,
-            };
-            HANDLE thread = CreateThread(NULL, 0, func_exec_timeout_win, &tinfo, 0, NULL);
-            if (thread == NULL) {
-                perror("Failed to create thread");
-                exit(EXIT_FAILURE);
-            }
-            DWORD wait_result = WaitForSingleObject(thread, timeout_time);
-            if (wait_result == WAIT_TIMEOUT) {
-                tstatus.status = Timeout;
-            } else if (wait_result == WAIT_FAILED) {
-                tstatus.status = Crashed;
-            }
-            timespec_get(&end, TIME_UTC);
-            long elapsed_ms =
-                (end.tv_sec - start.tv_sec) * 1000 + (end.tv_nsec - start.tv_nsec) / 1000000;
-            char *err_buf = NULL;
-            if (tstatus.msg) {
-                err_buf = tstatus.msg->buf;
-            }
-            switch (tstatus.status) {
-            case Success:
-                string_append(output, " " GREEN "[PASSED, %ldms]" RESET "\n%s\n", elapsed_ms,
-                              err_buf ? err_buf : "");
-                passed += 1;
-                break;
-            case Fail:
-                string_append(output, " " RED "[FAILED, %ldms]" RESET "\n%s\n", elapsed_ms,
-                              err_buf ? err_buf : "");
-                failed += 1;
-
-                break;
-            case Skip:
-                string_append(output, " " YELLOW "[SKIPPED, ⏭ ]" RESET "\n%s\n",
-                              err_buf ? err_buf : "");
-                skipped += 1;
-                break;
-            case Timeout:
-                string_append(output, " " GREY "[TIMEOUT, ⧖ ]" RESET "\n%s\n",
-                              err_buf ? err_buf : "");
-                timeout += 1;
-                break;
-            case Crashed:
-                string_append(output, " " MAGENTA "[CRASHED, ☠ ]" RESET "\n\n");
-                crashed += 1;
-                break;
-            default:
-                __builtin_unreachable();
-            };
-            if (tstatus.msg) {
-                string_free(tstatus.msg);
-            }
-            CloseHandle(thread);
-        }
-        test_vec_free(tv);
-    }
-
-    hashy_free(test_suites);
-    string_append(output, "%.*s\n\n", max_cols, DASHES);
-    string_append(output, "=== Test Run Summary ===\n");
-    string_append(output,
-                  "Total Tests: %zu | " GREEN "Passed" RESET ": %d | " RED "Failed" RESET
-                  ": %d | " MAGENTA "Crashed" RESET ": %d | " YELLOW "Skipped" RESET ": %d | " GREY
-                  "Timeout" RESET ": %d\n",
-                  tcount, passed, failed, crashed, skipped, timeout);
-    string_append(output, "%.*s\n", max_cols, DASHES);
-    fprintf(stdout, "%s", output->buf);
-    string_free(output);
-    if (crashed > 0 || failed > 0 || timeout > 0) {
-        return 1;
     }
-    return 0;
+    if (gen->log) {
+        souffle_log_msg_raw(gen->log, "Input %zu: %jd\n", ++gen->logged, (intmax_t)value);
+    }
+    return value;
 }
-#endif
 
-__attribute__((weak)) int
-main(void) {
+uint64_t
+souffle_gen_uint(SouffleGen *gen, uint64_t min, uint64_t max) {
+    assert(min <= max);
+    uint64_t value = min + gen_draw(gen, max - min);
+    if (gen->log) {
+        souffle_log_msg_raw(gen->log, "Input %zu: %ju\n", ++gen->logged, (uintmax_t)value);
+    }
+    return value;
+}
+
+double
+souffle_gen_double(SouffleGen *gen, double min, double max) {
+    assert(min <= max && isfinite(min) && isfinite(max));
+    double value;
+    if (min >= 0 || max <= 0) {
+        // a fraction of the way from the bound closest to 0, in steps of 2^-53.
+        double fraction = (double)gen_draw(gen, 1ull << 53) * 0x1p-53;
+        value = min >= 0 ? min + (max - min) * fraction : max - (max - min) * fraction;
+    } else {
+        bool negative = gen_draw(gen, 1);
+        double fraction = (double)gen_draw(gen, 1ull << 53) * 0x1p-53;
+        value = (negative ? min : max) * fraction;
+    }
+    value = value < min ? min : value > max ? max : value;
+    if (gen->log) {
+        souffle_log_msg_raw(gen->log, "Input %zu: %.17g\n", ++gen->logged, value);
+    }
+    return value;
+}
+
+// Between min_len and max_len elements, each the choice itself or, with an `alphabet`, the
+// character it picks. NUL terminated.
+static unsigned char *
+gen_elements(SouffleGen *gen, size_t *len, size_t min_len, size_t max_len, const char *alphabet,
+             uint64_t max) {
+    assert(min_len <= max_len);
+    uint64_t mean = max_len - min_len < GEN_MEAN_LEN ? max_len - min_len : GEN_MEAN_LEN;
+    size_t capacity = min_len + 16;
+    unsigned char *buf = malloc(capacity + 1);
+    assert(buf);
+    size_t n = 0;
+    while (n < min_len || (n < max_len && gen_more(gen, mean))) {
+        if (n == capacity) {
+            capacity *= 2;
+            buf = realloc(buf, capacity + 1);
+            assert(buf);
+        }
+        uint64_t choice = gen_draw(gen, max);
+        buf[n++] = alphabet ? (unsigned char)alphabet[choice] : (unsigned char)choice;
+    }
+    buf[n] = '\0';
+    gen_keep(gen, buf);
+    *len = n;
+    return buf;
+}
+
+const unsigned char *
+souffle_gen_bytes(SouffleGen *gen, size_t *len, size_t min_len, size_t max_len) {
+    unsigned char *buf = gen_elements(gen, len, min_len, max_len, NULL, UINT8_MAX);
+    if (gen->log) {
+        souffle_log_msg_raw(gen->log, "Input %zu: %zu bytes", ++gen->logged, *len);
+        for (size_t i = 0; i < *len && i < GEN_BYTES_SHOWN; ++i) {
+            souffle_log_msg_raw(gen->log, " %02x", buf[i]);
+        }
+        souffle_log_msg_raw(gen->log, "%s\n", *len > GEN_BYTES_SHOWN ? " ..." : "");
+    }
+    return buf;
+}
+
+const char *
+souffle_gen_str(SouffleGen *gen, size_t min_len, size_t max_len) {
+    size_t len;
+    char *str = (char *)gen_elements(gen, &len, min_len, max_len, GEN_ALPHABET,
+                                     sizeof(GEN_ALPHABET) - 2);
+    if (gen->log) {
+        souffle_log_msg_raw(gen->log, "Input %zu: \"", ++gen->logged);
+        log_escaped(gen->log, str, len);
+        souffle_log_msg_raw(gen->log, "\"\n");
+    }
+    return str;
+}
+
+// Runs the body on `source[0, source_len)`, or on random choices when `source` is NULL. The
+// failures of the body go to `log` if given, else they are only counted.
+static enum Status
+property_try(SouffleGen *gen, PropertyFunc prop, void **ctx, const uint64_t *source,
+             size_t source_len, StatusInfo *log) {
+    gen_reset(gen);
+    gen->source = source;
+    gen->source_len = source_len;
+    gen->log = log;
+    StatusInfo scratch = {.status = Success};
+    StatusInfo *status_info = log ? log : &scratch;
+    prop(status_info, ctx, gen);
+    if (scratch.msg) {
+        string_free(scratch.msg);
+    }
+    return status_info->failures > 0 ? Fail : status_info->status;
+}
+
+// Shortlex: fewer choices, else the first that differs is smaller.
+static bool
+choices_simpler(const uint64_t *a, size_t alen, const uint64_t *b, size_t blen) {
+    if (alen != blen) {
+        return alen < blen;
+    }
+    for (size_t i = 0; i < alen; ++i) {
+        if (a[i] != b[i]) {
+            return a[i] < b[i];
+        }
+    }
+    return false;
+}
+
+typedef struct Shrinker {
+    SouffleGen *gen;
+    PropertyFunc prop;
+    void **ctx;
+    // the simplest failing choices so far.
+    uint64_t *best;
+    size_t len;
+    // an edited copy of `best`, to try.
+    uint64_t *candidate;
+    size_t runs_left;
+    size_t steps;
+} Shrinker;
+
+// Replays candidate[0, len). If the body still fails, what it drew becomes `best` when simpler.
+static bool
+shrink_try(Shrinker *shrinker, size_t len) {
+    if (shrinker->runs_left == 0) {
+        return false;
+    }
+    shrinker->runs_left--;
+    SouffleGen *gen = shrinker->gen;
+    if (property_try(gen, shrinker->prop, shrinker->ctx, shrinker->candidate, len, NULL) != Fail ||
+        !choices_simpler(gen->drawn, gen->len, shrinker->best, shrinker->len)) {
+        return false;
+    }
+    memcpy(shrinker->best, gen->drawn, gen->len * sizeof(uint64_t));
+    shrinker->len = gen->len;
+    shrinker->steps++;
+    return true;
+}
+
+// Until nothing gets simpler: drop runs of choices (elements of a collection, draws the body no
+// longer makes), then bisect each choice down to the smallest that still fails.
+static void
+shrink(Shrinker *shrinker) {
+    bool progress = true;
+    while (progress && shrinker->runs_left > 0) {
+        progress = false;
+        for (size_t chunk = 8; chunk > 0; chunk /= 2) {
+            for (size_t i = shrinker->len; i-- > 0;) {
+                if (i + chunk > shrinker->len) {
+                    continue;
+                }
+                size_t tail = shrinker->len - i - chunk;
+                memcpy(shrinker->candidate, shrinker->best, i * sizeof(uint64_t));
+                memcpy(shrinker->candidate + i, shrinker->best + i + chunk,
+                       tail * sizeof(uint64_t));
+                progress = shrink_try(shrinker, i + tail) || progress;
+            }
+        }
+        for (size_t i = 0; i < shrinker->len; ++i) {
+            uint64_t lo = 0;
+            uint64_t hi = shrinker->best[i];
+            while (lo < hi && shrinker->runs_left > 0) {
+                // 0 first, the likeliest to be the answer.
+                uint64_t mid = lo == 0 ? 0 : lo + (hi - lo) / 2;
+                memcpy(shrinker->candidate, shrinker->best, shrinker->len * sizeof(uint64_t));
+                shrinker->candidate[i] = mid;
+                if (shrink_try(shrinker, shrinker->len)) {
+                    progress = true;
+                    if (i >= shrinker->len) {
+                        break;
+                    }
+                    hi = shrinker->best[i];
+                } else {
+                    lo = mid + 1;
+                }
+            }
+        }
+    }
+}
+
+// SOUFFLE_SEED, else a new seed every run.
+static uint64_t
+property_seed() {
+    const char *seed_str = getenv("SOUFFLE_SEED");
+    if (seed_str && *seed_str) {
+        return strtoull(seed_str, NULL, 0);
+    }
+    struct timespec now;
+    timespec_get(&now, TIME_UTC);
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static size_t
+property_runs() {
+    const char *runs_str = getenv("SOUFFLE_PROPERTY_RUNS");
+    long runs = runs_str ? atol(runs_str) : 0;
+    return runs > 0 ? (size_t)runs : PROPERTY_RUNS;
+}
+
+// Every run happens in this process: the inputs are tried until one fails, which is shrunk and
+// replayed once more with its failures and values logged. A property is seeded by its name, so
+// SOUFFLE_SEED reproduces it whatever else runs.
+void
+souffle_property(StatusInfo *status_info, void **ctx, PropertyFunc prop, const char *name) {
+    uint64_t seed = property_seed();
+    SouffleGen gen = {.rng = seed ^ fnv1a(FNV_OFFSET, name, strlen(name))};
+    size_t runs = property_runs();
+    size_t run = 0;
+    size_t discarded = 0;
+    enum Status status = Success;
+    while (run < runs && status != Fail) {
+        run++;
+        status = property_try(&gen, prop, ctx, NULL, 0, NULL);
+        discarded += status == Skip;
+    }
+    if (status == Fail) {
+        Shrinker shrinker = {
+            .gen = &gen,
+            .prop = prop,
+            .ctx = ctx,
+            .best = malloc((gen.len + 1) * sizeof(uint64_t)),
+            .len = gen.len,
+            .candidate = malloc((gen.len + 1) * sizeof(uint64_t)),
+            .runs_left = SHRINK_RUNS,
+        };
+        assert(shrinker.best && shrinker.candidate);
+        memcpy(shrinker.best, gen.drawn, gen.len * sizeof(uint64_t));
+        shrink(&shrinker);
+        souffle_log_msg_raw(status_info, "Falsified after %zu of %zu runs, shrunk %zu times",
+                            run, runs, shrinker.steps);
+        souffle_log_msg_raw(status_info, " (SOUFFLE_SEED=%ju)\n", (uintmax_t)seed);
+        if (property_try(&gen, prop, ctx, shrinker.best, shrinker.len, status_info) != Fail) {
+            failure_begin(status_info);
+            souffle_log_msg_raw(status_info, "The input no longer fails when replayed: flaky\n");
+        }
+        free(shrinker.best);
+        free(shrinker.candidate);
+    } else if (discarded == runs) {
+        status_info->status = Skip;
+    }
+    gen_reset(&gen);
+    free(gen.drawn);
+    free(gen.buffers);
+}
+
+// ---------------- BENCHMARKS ----------------
+
+// Rounds run once the iterations per round are calibrated, before the measured ones.
+#define BENCH_WARMUP_ROUNDS 10
+// Measured rounds, each a sample of the time per iteration. Past the time BENCH_SAMPLES rounds
+// should take, BENCH_MIN_SAMPLES are enough: when a single iteration outlasts a round.
+#define BENCH_SAMPLES 100
+#define BENCH_MIN_SAMPLES 5
+// How long a round should take: well above the clock's resolution, short enough for many samples.
+#define BENCH_ROUND_NS 2000000
+// Calibration gives up growing the rounds past this, for a loop the compiler emptied.
+#define BENCH_MAX_ITERATIONS 10000000000ull
+// Arguments a benchmark with a .range runs with at most.
+#define BENCH_MAX_ARGS 64
+// How much slower than its baseline a benchmark may get, in percent of the median, unless
+// SOUFFLE_BENCH_THRESHOLD says otherwise.
+#define BENCH_THRESHOLD 5.0
+// The p-value below which a benchmark is significantly slower than its baseline.
+#define BENCH_ALPHA 0.01
+
+typedef enum BenchPhase {
+    BenchStart,
+    BenchCalibrating,
+    BenchWarmup,
+    BenchMeasuring,
+    BenchDone,
+} BenchPhase;
+
+struct SouffleBench {
+    // BENCH_ARG, from the benchmark's .range.
+    uint64_t arg;
+    BenchPhase phase;
+    uint64_t iterations;
+    // rounds done in this phase, and their time.
+    size_t rounds;
+    double phase_ns;
+    // the clock when the round started.
+    uint64_t start;
+    // SOUFFLE_BENCH_CLOCK=tsc: the clock counts TSC ticks, `ns_per_tick` apart. Else nanoseconds.
+    bool tsc;
+    double ns_per_tick;
+    // nanoseconds per iteration of each measured round.
+    double samples[BENCH_SAMPLES];
+};
+
+static uint64_t
+clock_ns() {
+#ifndef _WIN32
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+#else
+    LARGE_INTEGER counter, frequency;
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+    return (uint64_t)((double)counter.QuadPart * 1e9 / (double)frequency.QuadPart);
+#endif
+}
+
+static uint64_t
+bench_clock(const SouffleBench *bench) {
+#ifdef HAVE_TSC
+    if (bench->tsc) {
+        return __rdtsc();
+    }
+#else
+    (void)bench;
+#endif
+    return clock_ns();
+}
+
+// Whether SOUFFLE_BENCH_CLOCK asks for the TSC, which then gets measured against the monotonic
+// clock over a few rounds' time.
+static bool
+bench_use_tsc(SouffleBench *bench) {
+    const char *clock_str = getenv("SOUFFLE_BENCH_CLOCK");
+    if (!clock_str || strcmp(clock_str, "tsc") != 0) {
+        return false;
+    }
+#ifdef HAVE_TSC
+    uint64_t ns_start = clock_ns();
+    uint64_t ticks_start = __rdtsc();
+    uint64_t ns_end;
+    do {
+        ns_end = clock_ns();
+    } while (ns_end - ns_start < 5 * BENCH_ROUND_NS);
+    bench->ns_per_tick = (double)(ns_end - ns_start) / (double)(__rdtsc() - ticks_start);
+    return true;
+#else
+    (void)bench;
+    return false;
+#endif
+}
+
+bool
+souffle_bench_next(SouffleBench *bench, uint64_t *left) {
+    uint64_t end = bench_clock(bench);
+    double round_ns = (double)(end - bench->start) * bench->ns_per_tick;
+    switch (bench->phase) {
+    case BenchStart:
+        bench->phase = BenchCalibrating;
+        bench->iterations = 1;
+        break;
+    case BenchCalibrating:
+        if (round_ns < BENCH_ROUND_NS / 10 && bench->iterations < BENCH_MAX_ITERATIONS) {
+            bench->iterations *= 10;
+            break;
+        }
+        double scaled = round_ns > 0 ? (double)bench->iterations * BENCH_ROUND_NS / round_ns
+                                     : BENCH_MAX_ITERATIONS;
+        scaled = scaled < BENCH_MAX_ITERATIONS ? scaled : BENCH_MAX_ITERATIONS;
+        bench->iterations = scaled > 1 ? (uint64_t)scaled : 1;
+        bench->phase = BenchWarmup;
+        break;
+    case BenchWarmup:
+        bench->phase_ns += round_ns;
+        if (++bench->rounds == BENCH_WARMUP_ROUNDS ||
+            bench->phase_ns >= BENCH_WARMUP_ROUNDS * BENCH_ROUND_NS) {
+            bench->phase = BenchMeasuring;
+            bench->rounds = 0;
+            bench->phase_ns = 0;
+        }
+        break;
+    case BenchMeasuring:
+        bench->samples[bench->rounds++] = round_ns / (double)bench->iterations;
+        bench->phase_ns += round_ns;
+        if (bench->rounds == BENCH_SAMPLES || (bench->rounds >= BENCH_MIN_SAMPLES &&
+                                               bench->phase_ns >= BENCH_SAMPLES * BENCH_ROUND_NS)) {
+            bench->phase = BenchDone;
+            return false;
+        }
+        break;
+    case BenchDone:
+        return false;
+    }
+    *left = bench->iterations - 1;
+    bench->start = bench_clock(bench);
+    return true;
+}
+
+uint64_t
+souffle_bench_arg(const SouffleBench *bench) {
+    return bench->arg;
+}
+
+static int
+double_cmp(const void *a, const void *b) {
+    double da = *(const double *)a;
+    double db = *(const double *)b;
+    return (da > db) - (da < db);
+}
+
+// Writes `ns` with the unit that keeps it readable.
+static const char *
+bench_duration(char *buf, size_t size, double ns) {
+    if (ns < 0.01) {
+        snprintf(buf, size, "%.3g ns", ns);
+    } else if (ns < 1e3) {
+        snprintf(buf, size, "%.2f ns", ns);
+    } else if (ns < 1e6) {
+        snprintf(buf, size, "%.2f us", ns / 1e3);
+    } else if (ns < 1e9) {
+        snprintf(buf, size, "%.2f ms", ns / 1e6);
+    } else {
+        snprintf(buf, size, "%.2f s", ns / 1e9);
+    }
+    return buf;
+}
+
+// The median of sorted[0, len).
+static double
+median_of(const double *sorted, size_t len) {
+    return (sorted[(len - 1) / 2] + sorted[len / 2]) / 2;
+}
+
+typedef struct BenchStats {
+    // over all the measured rounds.
+    double per_op;
+    // of the rounds' time per iteration: MAD is the median absolute deviation from the median,
+    // p99 the nearest rank.
+    double median;
+    double mad;
+    double p99;
+} BenchStats;
+
+static BenchStats
+bench_stats(SouffleBench *bench) {
+    size_t len = bench->rounds;
+    double *samples = bench->samples;
+    qsort(samples, len, sizeof(double), double_cmp);
+    BenchStats stats = {
+        .per_op = bench->phase_ns / ((double)bench->iterations * (double)len),
+        .median = median_of(samples, len),
+        .p99 = samples[(len * 99 + 99) / 100 - 1],
+    };
+    double deviations[BENCH_SAMPLES];
+    for (size_t i = 0; i < len; ++i) {
+        deviations[i] = fabs(samples[i] - stats.median);
+    }
+    qsort(deviations, len, sizeof(double), double_cmp);
+    stats.mad = median_of(deviations, len);
+    return stats;
+}
+
+// SOUFFLE_BENCH_SAVE: a line per benchmark, "suite.name[/arg] count sample...", with the samples
+// in nanoseconds. The runner empties the file, then each benchmark appends its line in one write.
+static void
+baseline_reset() {
+    const char *path = getenv("SOUFFLE_BENCH_SAVE");
+    FILE *file = path ? fopen(path, "w") : NULL;
+    if (path && !file) {
+        perror("Failed to open SOUFFLE_BENCH_SAVE");
+        exit(EXIT_FAILURE);
+    }
+    if (file) {
+        fclose(file);
+    }
+}
+
+static void
+baseline_save(const char *key, const SouffleBench *bench) {
+    const char *path = getenv("SOUFFLE_BENCH_SAVE");
+    if (!path) {
+        return;
+    }
+    SouffleString *line = string_init();
+    string_grow(line, "%s %zu", key, bench->rounds);
+    for (size_t i = 0; i < bench->rounds; ++i) {
+        string_grow(line, " %.6g", bench->samples[i]);
+    }
+    string_grow(line, "\n");
+    FILE *file = fopen(path, "a");
+    if (file) {
+        fwrite(line->buf, 1, line->len, file);
+        fclose(file);
+    } else {
+        perror("Failed to open SOUFFLE_BENCH_SAVE");
+    }
+    string_free(line);
+}
+
+// The samples of `key` in the SOUFFLE_BENCH_BASELINE file, from its last line. 0 if it has none.
+static size_t
+baseline_load(const char *path, const char *key, double *samples, size_t max) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return 0;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char *text = malloc(size > 0 ? size + 1 : 1);
+    assert(text);
+    text[size > 0 ? fread(text, 1, size, file) : 0] = '\0';
+    fclose(file);
+    size_t key_len = strlen(key);
+    size_t count = 0;
+    for (char *line = text; *line;) {
+        char *end = strchr(line, '\n');
+        end = end ? end : line + strlen(line);
+        if (strncmp(line, key, key_len) == 0 && line[key_len] == ' ') {
+            char *pos = line + key_len;
+            size_t n = strtoul(pos, &pos, 10);
+            for (count = 0; count < n && count < max && pos < end; ++count) {
+                samples[count] = strtod(pos, &pos);
+            }
+        }
+        line = *end ? end + 1 : end;
+    }
+    free(text);
+    return count;
+}
+
+typedef struct Ranked {
+    double value;
+    bool current;
+} Ranked;
+
+static int
+ranked_cmp(const void *a, const void *b) {
+    return double_cmp(&((const Ranked *)a)->value, &((const Ranked *)b)->value);
+}
+
+// One-sided Mann-Whitney U test: the p-value of `current` being no slower than `baseline`, from
+// the normal approximation with the tie correction and a continuity correction.
+static double
+mann_whitney_p(const double *baseline, size_t n1, const double *current, size_t n2) {
+    Ranked all[2 * BENCH_SAMPLES];
+    size_t n = 0;
+    for (size_t i = 0; i < n1; ++i) {
+        all[n++] = (Ranked){.value = baseline[i]};
+    }
+    for (size_t i = 0; i < n2; ++i) {
+        all[n++] = (Ranked){.value = current[i], .current = true};
+    }
+    qsort(all, n, sizeof(Ranked), ranked_cmp);
+    double rank_sum = 0;
+    double ties = 0;
+    for (size_t i = 0; i < n;) {
+        size_t j = i;
+        while (j < n && all[j].value == all[i].value) {
+            j++;
+        }
+        // ranks i + 1 to j share their average.
+        double rank = (double)(i + 1 + j) / 2;
+        for (size_t k = i; k < j; ++k) {
+            rank_sum += all[k].current ? rank : 0;
+        }
+        double t = (double)(j - i);
+        ties += t * t * t - t;
+        i = j;
+    }
+    double u = rank_sum - (double)n2 * (double)(n2 + 1) / 2;
+    double mean = (double)n1 * (double)n2 / 2;
+    double variance =
+        (double)n1 * (double)n2 / 12 * ((double)(n + 1) - ties / ((double)n * (double)(n - 1)));
+    if (variance <= 0) {
+        return u > mean ? 0 : 1;
+    }
+    double z = (u - mean - 0.5) / sqrt(variance);
+    return 0.5 * erfc(z / sqrt(2));
+}
+
+// SOUFFLE_BENCH_BASELINE: marks the benchmark Regressed when its samples are significantly slower
+// than the baseline's and the median grew by more than SOUFFLE_BENCH_THRESHOLD percent.
+static void
+baseline_compare(StatusInfo *status_info, const char *key, const SouffleBench *bench,
+                 double median) {
+    const char *path = getenv("SOUFFLE_BENCH_BASELINE");
+    if (!path) {
+        return;
+    }
+    double baseline[BENCH_SAMPLES];
+    size_t n = baseline_load(path, key, baseline, BENCH_SAMPLES);
+    if (n == 0) {
+        souffle_log_msg_raw(status_info, "%s: not in the baseline\n", key);
+        return;
+    }
+    qsort(baseline, n, sizeof(double), double_cmp);
+    double base_median = median_of(baseline, n);
+    double change = base_median > 0 ? (median / base_median - 1) * 100 : 0;
+    double p = mann_whitney_p(baseline, n, bench->samples, bench->rounds);
+    const char *threshold_str = getenv("SOUFFLE_BENCH_THRESHOLD");
+    double threshold = threshold_str ? atof(threshold_str) : BENCH_THRESHOLD;
+    bool regressed = p < BENCH_ALPHA && change > threshold;
+    char bufs[2][32];
+    souffle_log_msg_raw(status_info, "%s: median %s -> %s (%+.1f%%), p = %.2g%s\n", key,
+                        bench_duration(bufs[0], sizeof(bufs[0]), base_median),
+                        bench_duration(bufs[1], sizeof(bufs[1]), median), change, p,
+                        regressed ? ", regressed" : "");
+    if (regressed) {
+        status_info->status = Regressed;
+    }
+}
+
+static void
+bench_report(StatusInfo *status_info, const char *name, SouffleBench *bench) {
+    BenchStats stats = bench_stats(bench);
+    char bufs[4][32];
+    souffle_log_msg_raw(status_info, "%s/op | median %s | MAD %s | p99 %s\n",
+                        bench_duration(bufs[0], sizeof(bufs[0]), stats.per_op),
+                        bench_duration(bufs[1], sizeof(bufs[1]), stats.median),
+                        bench_duration(bufs[2], sizeof(bufs[2]), stats.mad),
+                        bench_duration(bufs[3], sizeof(bufs[3]), stats.p99));
+    souffle_log_msg_raw(status_info, "%zu rounds of %ju iterations, %s clock\n", bench->rounds,
+                        (uintmax_t)bench->iterations, bench->tsc ? "TSC" : "monotonic");
+    baseline_save(name, bench);
+    baseline_compare(status_info, name, bench, stats.median);
+}
+
+static double
+complexity_1(double n) {
+    (void)n;
+    return 1;
+}
+
+static double
+complexity_log_n(double n) {
+    return log2(n);
+}
+
+static double
+complexity_n(double n) {
+    return n;
+}
+
+static double
+complexity_n_log_n(double n) {
+    return n * log2(n);
+}
+
+static double
+complexity_n2(double n) {
+    return n * n;
+}
+
+static const struct {
+    const char *name;
+    // the unit the coefficient is given in.
+    const char *unit;
+    double (*f)(double n);
+} COMPLEXITIES[] = {
+    {"O(1)", "", complexity_1},
+    {"O(log n)", " * log n", complexity_log_n},
+    {"O(n)", " * n", complexity_n},
+    {"O(n log n)", " * n log n", complexity_n_log_n},
+    {"O(n^2)", " * n^2", complexity_n2},
+};
+
+#define NCOMPLEXITIES (sizeof(COMPLEXITIES) / sizeof(COMPLEXITIES[0]))
+
+// Least squares fits of times[i] = coef * f(args[i]) for every complexity f, the one with the
+// smallest RMS error best. Errors are relative to the mean time, so that they compare.
+static void
+bench_fit(StatusInfo *status_info, const uint64_t *args, const double *times, size_t len) {
+    double mean = 0;
+    for (size_t i = 0; i < len; ++i) {
+        mean += times[i] / (double)len;
+    }
+    double coefs[NCOMPLEXITIES];
+    double errors[NCOMPLEXITIES];
+    size_t best = 0;
+    for (size_t c = 0; c < NCOMPLEXITIES; ++c) {
+        double ft = 0;
+        double ff = 0;
+        for (size_t i = 0; i < len; ++i) {
+            double f = COMPLEXITIES[c].f((double)args[i]);
+            ft += f * times[i];
+            ff += f * f;
+        }
+        coefs[c] = ff > 0 ? ft / ff : 0;
+        double squares = 0;
+        for (size_t i = 0; i < len; ++i) {
+            double residual = times[i] - coefs[c] * COMPLEXITIES[c].f((double)args[i]);
+            squares += residual * residual;
+        }
+        errors[c] = mean > 0 ? sqrt(squares / (double)len) / mean : 0;
+        best = errors[c] < errors[best] ? c : best;
+    }
+    char buf[32];
+    souffle_log_msg_raw(status_info, "Best fit %s: %s%s, RMS error %.1f%%\n",
+                        COMPLEXITIES[best].name, bench_duration(buf, sizeof(buf), coefs[best]),
+                        COMPLEXITIES[best].unit, errors[best] * 100);
+    souffle_log_msg_raw(status_info, "RMS error");
+    for (size_t c = 0; c < NCOMPLEXITIES; ++c) {
+        souffle_log_msg_raw(status_info, "%s %s %.1f%%", c ? " |" : "", COMPLEXITIES[c].name,
+                            errors[c] * 100);
+    }
+    souffle_log_msg_raw(status_info, "\n");
+}
+
+// Runs `func` once per argument of the range: the powers of two times range.min up to range.max,
+// and range.max itself. Logs a row of statistics per argument, then the complexity they fit.
+static void
+bench_range(StatusInfo *status_info, void **ctx, BenchFunc func, const char *name,
+            SouffleBench *bench, BenchRange range) {
+    uint64_t args[BENCH_MAX_ARGS];
+    double times[BENCH_MAX_ARGS];
+    size_t len = 0;
+    char bufs[3][32];
+    char key[strlen(name) + 32];
+    souffle_log_msg_raw(status_info, "%12s  %12s  %12s  %12s\n", "n", "ns/op", "median", "MAD");
+    for (uint64_t arg = range.min ? range.min : 1; len < BENCH_MAX_ARGS; arg *= 2) {
+        arg = arg < range.max ? arg : range.max;
+        bench->arg = arg;
+        bench->phase = BenchStart;
+        bench->rounds = 0;
+        bench->phase_ns = 0;
+        func(status_info, ctx, bench);
+        if ((status_info->status != Success && status_info->status != Regressed) ||
+            status_info->failures > 0 || bench->phase != BenchDone) {
+            return;
+        }
+        BenchStats stats = bench_stats(bench);
+        souffle_log_msg_raw(status_info, "%12ju  %12s  %12s  %12s\n", (uintmax_t)arg,
+                            bench_duration(bufs[0], sizeof(bufs[0]), stats.per_op),
+                            bench_duration(bufs[1], sizeof(bufs[1]), stats.median),
+                            bench_duration(bufs[2], sizeof(bufs[2]), stats.mad));
+        snprintf(key, sizeof(key), "%s/%ju", name, (uintmax_t)arg);
+        baseline_save(key, bench);
+        baseline_compare(status_info, key, bench, stats.median);
+        args[len] = arg;
+        times[len++] = stats.median;
+        if (arg >= range.max || arg > UINT64_MAX / 2) {
+            break;
+        }
+    }
+    if (len > 1) {
+        bench_fit(status_info, args, times, len);
+    }
+}
+
+void
+souffle_bench(StatusInfo *status_info, void **ctx, BenchFunc func, const char *name,
+              BenchRange range) {
+    SouffleBench bench = {.ns_per_tick = 1};
+    bench.tsc = bench_use_tsc(&bench);
+    if (range.max > 0) {
+        bench_range(status_info, ctx, func, name, &bench, range);
+    } else {
+        func(status_info, ctx, &bench);
+    }
+    if ((status_info->status != Success && status_info->status != Regressed) ||
+        status_info->failures > 0) {
+        return;
+    }
+    if (bench.phase != BenchDone) {
+        failure_begin(status_info);
+        souffle_log_msg_raw(status_info, "The benchmark left its BENCH_LOOP before the end\n");
+        return;
+    }
+    if (range.max == 0) {
+        bench_report(status_info, name, &bench);
+    }
+}
+
+// SOUFFLE_BENCH=1: run the benchmarks instead of the tests.
+static bool
+bench_mode() {
+    const char *bench_str = getenv("SOUFFLE_BENCH");
+    return bench_str && strcmp(bench_str, "1") == 0;
+}
+
+// Registered ranges of Test descriptors.
+typedef struct TestRange {
+    Test *first;
+    Test *end;
+} TestRange;
+
+static TestRange *test_ranges = NULL;
+static size_t nranges = 0;
+static size_t ranges_capacity = 0;
+
+// Every test, grouped by suite, collected once the program starts.
+static Test **tests = NULL;
+static size_t tcount = 0;
+static int largest_name = 0;
+
+// Tags are indexed once when the tests are collected: each distinct tag gets a bit, so selecting
+// by tag is a mask test per test.
+#define MAX_TAGS 64
+
+static HashTable *tag_index;
+static size_t tag_count = 0;
+
+// The bit of the `len` bytes long `tag`. A tag seen for the first time gets a new bit if
+// `assign`, 0 otherwise.
+static uint64_t
+tag_bit(const char *tag, size_t len, bool assign) {
+    char key[len + 1];
+    memcpy(key, tag, len);
+    key[len] = '\0';
+    if (tag_index == NULL) {
+        if (!assign) {
+            return 0;
+        }
+        tag_index = hashy_init();
+        assert(tag_index);
+    }
+    void *bit = hashy_get(tag_index, key);
+    if (bit) {
+        return (uint64_t)1 << ((uintptr_t)bit - 1);
+    }
+    if (!assign) {
+        return 0;
+    }
+    if (tag_count == MAX_TAGS) {
+        fprintf(stderr, "Too many distinct tags (at most %d): %s\n", MAX_TAGS, key);
+        exit(EXIT_FAILURE);
+    }
+    hashy_insert(tag_index, key, (void *)(uintptr_t)++tag_count);
+    return (uint64_t)1 << (tag_count - 1);
+}
+
+static uint64_t
+tags_mask(const char *tags) {
+    uint64_t mask = 0;
+    while (tags) {
+        tags += strspn(tags, ", ");
+        size_t len = strcspn(tags, ", ");
+        if (len == 0) {
+            break;
+        }
+        mask |= tag_bit(tags, len, true);
+        tags += len;
+    }
+    return mask;
+}
+
+void
+register_tests(Test *first, Test *end) {
+    // every file of a module registers the module's section, one after another.
+    if (first == end || (nranges > 0 && test_ranges[nranges - 1].first == first)) {
+        return;
+    }
+    if (nranges == ranges_capacity) {
+        ranges_capacity = ranges_capacity ? ranges_capacity * 2 : 16;
+        test_ranges = realloc(test_ranges, ranges_capacity * sizeof(TestRange));
+        assert(test_ranges);
+    }
+    test_ranges[nranges++] = (TestRange){.first = first, .end = end};
+}
+
+void
+register_test(const char *suite, const char *name, TestFunc func, SetupFunc setup,
+              TeardownFunc teardown, SetupFunc suite_setup, TeardownFunc suite_teardown,
+              TestOptions options) {
+    Test *test = malloc(sizeof(Test));
+    assert(test);
+    *test = (Test){
+        .suite = suite,
+        .name = name,
+        .func = func,
+        .setup = setup,
+        .teardown = teardown,
+        .suite_setup = suite_setup,
+        .suite_teardown = suite_teardown,
+        .options = options,
+        .file = "",
+    };
+    register_tests(test, test + 1);
+}
+
+// Suites by name, then the tests of a suite in source order.
+static int
+test_cmp(const void *a, const void *b) {
+    const Test *ta = *(const Test *const *)a;
+    const Test *tb = *(const Test *const *)b;
+    int cmp = ta->suite == tb->suite ? 0 : strcmp(ta->suite, tb->suite);
+    if (cmp == 0 && ta->file != tb->file) {
+        cmp = strcmp(ta->file, tb->file);
+    }
+    if (cmp == 0 && ta->line != tb->line) {
+        cmp = ta->line < tb->line ? -1 : 1;
+    }
+    return cmp ? cmp : (ta < tb ? -1 : ta > tb);
+}
+
+// Length of the "/row_<i>" suffix of the last row of a table of `nrows` rows.
+static int
+row_suffix_len(size_t nrows) {
+    return snprintf(NULL, 0, "/row_%zu", nrows - 1);
+}
+
+// Gather the registered tests into `tests` with a single sort. The tests of a suite then share
+// one suite string, so that runs tell suites apart by pointer.
+static void
+collect_tests() {
+    if (tests) {
+        return;
+    }
+    size_t total = 0;
+    for (size_t r = 0; r < nranges; ++r) {
+        total += test_ranges[r].end - test_ranges[r].first;
+    }
+    tests = malloc((total + 1) * sizeof(Test *));
+    assert(tests);
+    for (size_t r = 0; r < nranges; ++r) {
+        for (Test *test = test_ranges[r].first; test < test_ranges[r].end; ++test) {
+            tests[tcount++] = test;
+        }
+    }
+    qsort(tests, tcount, sizeof(Test *), test_cmp);
+    for (size_t t = 0; t < tcount; ++t) {
+        Test *test = tests[t];
+        if (t > 0 && strcmp(test->suite, tests[t - 1]->suite) == 0) {
+            test->suite = tests[t - 1]->suite;
+        } else if ((int)strlen(test->suite) > largest_name) {
+            largest_name = strlen(test->suite);
+        }
+        int name_len = strlen(test->name) + (test->nrows ? row_suffix_len(test->nrows) : 0);
+        if (name_len > largest_name) {
+            largest_name = name_len;
+        }
+        if (test->options.tags) {
+            test->tag_mask = tags_mask(test->options.tags);
+        }
+    }
+}
+
+static void
+tests_free() {
+    free(tests);
+    free(test_ranges);
+}
+
+// '*' matches any run of characters, '?' any single one.
+static bool
+glob_match(const char *pattern, const char *str) {
+    const char *star = NULL;
+    const char *resume = NULL;
+    while (*str) {
+        if (*pattern == '?' || *pattern == *str) {
+            pattern++;
+            str++;
+        } else if (*pattern == '*') {
+            star = pattern++;
+            resume = str;
+        } else if (star) {
+            pattern = star + 1;
+            str = ++resume;
+        } else {
+            return false;
+        }
+    }
+    while (*pattern == '*') {
+        pattern++;
+    }
+    return *pattern == '\0';
+}
+
+// One SOUFFLE_FILTER pattern: "suite.name" globs ("suite" alone selects the whole suite), or
+// "@tag". A leading '-' excludes what it matches.
+typedef struct FilterPattern {
+    char *text;
+    bool exclude;
+    bool is_tag;
+    uint64_t tag_mask;
+    const char *suite;
+    const char *name;
+} FilterPattern;
+
+// Suite globs are matched once per suite (`suite_hits`), so a test only costs its tag mask and
+// the name globs of the patterns that selected its suite.
+typedef struct Filter {
+    FilterPattern *patterns;
+    size_t len;
+    bool has_include;
+    bool *suite_hits;
+} Filter;
+
+static Filter
+filter_init() {
+    Filter filter = {0};
+    const char *spec = getenv("SOUFFLE_FILTER");
+    if (spec == NULL) {
+        return filter;
+    }
+    // at most one pattern per two characters of the spec.
+    filter.patterns = calloc(strlen(spec) / 2 + 1, sizeof(FilterPattern));
+    assert(filter.patterns);
+    while (true) {
+        spec += strspn(spec, ", ");
+        size_t len = strcspn(spec, ", ");
+        if (len == 0) {
+            break;
+        }
+        FilterPattern *pattern = &filter.patterns[filter.len++];
+        pattern->text = malloc(len + 1);
+        assert(pattern->text);
+        memcpy(pattern->text, spec, len);
+        pattern->text[len] = '\0';
+        spec += len;
+
+        char *text = pattern->text;
+        pattern->exclude = text[0] == '-';
+        text += pattern->exclude;
+        filter.has_include = filter.has_include || !pattern->exclude;
+        if (text[0] == '@') {
+            pattern->is_tag = true;
+            pattern->tag_mask = tag_bit(text + 1, strlen(text + 1), false);
+            continue;
+        }
+        char *dot = strchr(text, '.');
+        pattern->suite = text;
+        pattern->name = "*";
+        if (dot) {
+            *dot = '\0';
+            pattern->name = dot + 1;
+        }
+    }
+    filter.suite_hits = calloc(filter.len + 1, sizeof(bool));
+    assert(filter.suite_hits);
+    return filter;
+}
+
+static void
+filter_free(Filter *filter) {
+    for (size_t i = 0; i < filter->len; ++i) {
+        free(filter->patterns[i].text);
+    }
+    free(filter->patterns);
+    free(filter->suite_hits);
+}
+
+// Match every pattern against `suite`. Returns false if none of its tests can be selected.
+static bool
+filter_suite(Filter *filter, const char *suite) {
+    bool possible = !filter->has_include;
+    for (size_t i = 0; i < filter->len; ++i) {
+        const FilterPattern *pattern = &filter->patterns[i];
+        filter->suite_hits[i] = !pattern->is_tag && glob_match(pattern->suite, suite);
+        if (!pattern->exclude && (pattern->is_tag || filter->suite_hits[i])) {
+            possible = true;
+        }
+    }
+    return possible;
+}
+
+// Whether the run `name` of `test`, from the suite last passed to filter_suite(), is selected. The
+// rows of a TEST_P are also selected by the name of the test.
+static bool
+filter_test(const Filter *filter, const Test *test, const char *name) {
+    bool selected = !filter->has_include;
+    for (size_t i = 0; i < filter->len; ++i) {
+        const FilterPattern *pattern = &filter->patterns[i];
+        bool hit;
+        if (pattern->is_tag) {
+            hit = (test->tag_mask & pattern->tag_mask) != 0;
+        } else {
+            hit = filter->suite_hits[i] &&
+                  (glob_match(pattern->name, name) ||
+                   (name != test->name && glob_match(pattern->name, test->name)));
+        }
+        if (hit && pattern->exclude) {
+            return false;
+        }
+        selected = selected || hit;
+    }
+    return selected;
+}
+
+// Counters a test can get from SOUFFLE_PERF at most.
+#define PERF_MAX_EVENTS 8
+
+// The events SOUFFLE_PERF counts in every test. None unless it is set, and only on Linux.
+static size_t perf_len = 0;
+static const char *perf_names[PERF_MAX_EVENTS];
+
+// A single test scheduled for execution. Runs are kept in registration order so the results can
+// be printed in that order no matter which child finishes first.
+typedef struct TestRun {
+    const char *suite;
+    const Test *test;
+    // test->name, or "name/row_<i>" for the row `row` of a TEST_P.
+    const char *name;
+    size_t row;
+    enum Status status;
+    long elapsed_ms;
+    // what the test logged, owned by the run until it is reported.
+    char *msg;
+    bool truncated;
+    // perf_len counts from SOUFFLE_PERF, NULL if the test has none.
+    const uint64_t *perf;
+    const ResourceUsage *usage;
+    bool done;
+    // from SOUFFLE_HISTORY, when the test ran before.
+    bool known;
+    long expected_ms;
+    long history_timeout_ms;
+    bool failed_before;
+    // passed last time in the same binary, not run again.
+    bool cached;
+} TestRun;
+
+#ifndef _WIN32
+// Sets `known` and `expected_ms` from SOUFFLE_HISTORY, if there is one, for shard_runs().
+static void history_weigh(TestRun *runs, size_t nruns);
+#endif
+
+// SOUFFLE_SHARD_INDEX/SOUFFLE_SHARD_COUNT: this process runs shard `index` (0-based) of `count`.
+typedef struct Shard {
+    long index;
+    long count;
+} Shard;
+
+// The runs of this process: the tests SOUFFLE_FILTER selects, cut down to its shard. Runs stay
+// grouped by suite, in registration order.
+typedef struct RunList {
+    TestRun *runs;
+    size_t len;
+    // the names of the TEST_P rows.
+    char *row_names;
+    // selected tests before sharding.
+    size_t selected;
+    int suites;
+    Shard shard;
+} RunList;
+
+static Shard
+shard_config() {
+    Shard shard = {.index = 0, .count = 1};
+    const char *index_str = getenv("SOUFFLE_SHARD_INDEX");
+    const char *count_str = getenv("SOUFFLE_SHARD_COUNT");
+    if (index_str == NULL && count_str == NULL) {
+        return shard;
+    }
+    char *index_end = "";
+    char *count_end = "";
+    if (index_str) {
+        shard.index = strtol(index_str, &index_end, 10);
+    }
+    if (count_str) {
+        shard.count = strtol(count_str, &count_end, 10);
+    }
+    if (*index_end || *count_end || shard.count < 1 || shard.index < 0 ||
+        shard.index >= shard.count) {
+        fprintf(stderr, "Invalid shard: SOUFFLE_SHARD_INDEX must be in [0, SOUFFLE_SHARD_COUNT)\n");
+        exit(EXIT_FAILURE);
+    }
+    return shard;
+}
+
+// Order of the runs by full name, which doesn't depend on how hashy lays out the suites.
+static int
+run_name_cmp(const void *a, const void *b) {
+    const TestRun *ra = *(const TestRun *const *)a;
+    const TestRun *rb = *(const TestRun *const *)b;
+    int cmp = strcmp(ra->suite, rb->suite);
+    return cmp ? cmp : strcmp(ra->name, rb->name);
+}
+
+// What shard_runs() weighs a run by: its expected duration in ms, plus one for what starting it
+// costs. A test the history doesn't know weighs as much as the average known test, and without a
+// history every test weighs 1.
+static uint64_t
+run_weight(const TestRun *run, uint64_t unknown) {
+    return run->known ? (uint64_t)run->expected_ms + 1 : unknown;
+}
+
+// Keep the runs of `shard` only. The selected tests are sorted by name and cut into `count`
+// contiguous blocks of about the same weight: a test goes to the shard its middle falls in, on a
+// line where each test takes as much room as it weighs. As long as every process reads the same
+// history they compute the same split; the shards cover every test exactly once, and a suite stays
+// on as few shards as possible.
+static size_t
+shard_runs(TestRun *runs, size_t nruns, Shard shard) {
+    TestRun **order = malloc((nruns + 1) * sizeof(TestRun *));
+    bool *keep = calloc(nruns + 1, sizeof(bool));
+    assert(order && keep);
+    uint64_t known_ms = 0;
+    size_t known = 0;
+    for (size_t i = 0; i < nruns; ++i) {
+        order[i] = &runs[i];
+        known_ms += runs[i].known ? runs[i].expected_ms + 1 : 0;
+        known += runs[i].known;
+    }
+    qsort(order, nruns, sizeof(TestRun *), run_name_cmp);
+    uint64_t unknown = known ? (known_ms + known / 2) / known : 1;
+    uint64_t total = 0;
+    for (size_t i = 0; i < nruns; ++i) {
+        total += run_weight(order[i], unknown);
+    }
+    uint64_t before = 0;
+    for (size_t i = 0; i < nruns; ++i) {
+        uint64_t weight = run_weight(order[i], unknown);
+        uint64_t middle = 2 * before + weight;
+        keep[order[i] - runs] = middle * shard.count / (2 * total) == (uint64_t)shard.index;
+        before += weight;
+    }
+    size_t kept = 0;
+    for (size_t i = 0; i < nruns; ++i) {
+        if (keep[i]) {
+            runs[kept++] = runs[i];
+        }
+    }
+    free(order);
+    free(keep);
+    return kept;
+}
+
+// A TEST_P makes one run per row of its table.
+static RunList
+select_runs() {
+    RunList list = {.shard = shard_config()};
+    collect_tests();
+    size_t nruns = 0;
+    size_t names_size = 0;
+    for (size_t t = 0; t < tcount; ++t) {
+        const Test *test = tests[t];
+        nruns += test->nrows ? test->nrows : 1;
+        names_size += test->nrows * (strlen(test->name) + row_suffix_len(test->nrows) + 1);
+    }
+    list.runs = calloc(nruns + 1, sizeof(TestRun));
+    list.row_names = malloc(names_size + 1);
+    assert(list.runs && list.row_names);
+    char *row_name = list.row_names;
+    Filter filter = filter_init();
+    bool suite_selected = false;
+    bool benches = bench_mode();
+    for (size_t t = 0; t < tcount; ++t) {
+        const Test *test = tests[t];
+        if (t == 0 || test->suite != tests[t - 1]->suite) {
+            suite_selected = filter_suite(&filter, test->suite);
+        }
+        if (!suite_selected || test->bench != benches) {
+            continue;
+        }
+        if (test->nrows == 0 && filter_test(&filter, test, test->name)) {
+            list.runs[list.len++] =
+                (TestRun){.suite = test->suite, .test = test, .name = test->name};
+        }
+        for (size_t row = 0; row < test->nrows; ++row) {
+            int len = sprintf(row_name, "%s/row_%zu", test->name, row);
+            if (filter_test(&filter, test, row_name)) {
+                list.runs[list.len++] =
+                    (TestRun){.suite = test->suite, .test = test, .name = row_name, .row = row};
+                row_name += len + 1;
+            }
+        }
+    }
+    filter_free(&filter);
+    list.selected = list.len;
+    if (list.shard.count > 1) {
+#ifndef _WIN32
+        history_weigh(list.runs, list.len);
+#endif
+        list.len = shard_runs(list.runs, list.len, list.shard);
+    }
+    for (size_t r = 0; r < list.len; ++r) {
+        list.suites += r == 0 || list.runs[r].suite != list.runs[r - 1].suite;
+    }
+    return list;
+}
+
+// The table row a run of a TEST_P gets, NULL for other tests.
+static const void *
+run_param(const TestRun *run) {
+    const Test *test = run->test;
+    return test->nrows ? (const char *)test->rows + run->row * test->row_size : NULL;
+}
+
+static void
+runs_free(RunList *list) {
+    free(list->runs);
+    free(list->row_names);
+}
+
+// SOUFFLE_FAIL_FAST: give up after that many failed, crashed or timed out tests ("1" for the
+// first one), 0 to run everything.
+static long
+fail_fast_limit() {
+    const char *limit_str = getenv("SOUFFLE_FAIL_FAST");
+    long limit = limit_str ? atol(limit_str) : 0;
+    return limit > 0 ? limit : 0;
+}
+
+static bool
+status_failed(enum Status status) {
+    return status == Fail || status == Crashed || status == Timeout || status == Regressed;
+}
+
+// The tests in `counts` that didn't pass, by status_failed().
+static int
+failed_count(const int *counts) {
+    return counts[Fail] + counts[Crashed] + counts[Timeout] + counts[Regressed];
+}
+
+// Size of the console reporter's buffer, written out whenever it fills up.
+#define REPORT_BUF_SIZE 16384
+
+// Reporters fed by the runner: the console, those registered by the program and the
+// SOUFFLE_REPORT files.
+#define MAX_REPORTERS 16
+
+static TestReporter reporters[MAX_REPORTERS];
+static int nreporters = 0;
+// suite of the last test reported.
+static const char *reported_suite = NULL;
+
+void
+register_reporter(TestReporter reporter) {
+    if (nreporters == MAX_REPORTERS) {
+        fprintf(stderr, "Too many reporters, at most %d\n", MAX_REPORTERS);
+        exit(EXIT_FAILURE);
+    }
+    reporters[nreporters++] = reporter;
+}
+
+static void
+report_start(size_t ntests) {
+    for (int i = 0; i < nreporters; ++i) {
+        if (reporters[i].on_run_start) {
+            reporters[i].on_run_start(reporters[i].data, ntests);
+        }
+    }
+}
+
+static void
+report_test(const TestRun *run) {
+    if (reported_suite != run->suite) {
+        reported_suite = run->suite;
+        for (int i = 0; i < nreporters; ++i) {
+            if (reporters[i].on_suite_start) {
+                reporters[i].on_suite_start(reporters[i].data, run->suite);
+            }
+        }
+    }
+    PerfCount perf[PERF_MAX_EVENTS];
+    size_t nperf = run->perf ? perf_len : 0;
+    for (size_t i = 0; i < nperf; ++i) {
+        perf[i] = (PerfCount){.event = perf_names[i], .value = run->perf[i]};
+    }
+    TestResult result = {
+        .suite = run->suite,
+        .test = run->test,
+        .name = run->name,
+        .status = run->status,
+        .elapsed_ms = run->elapsed_ms,
+        .msg = run->msg,
+        .truncated = run->truncated,
+        .cached = run->cached,
+        .perf = nperf > 0 ? perf : NULL,
+        .nperf = nperf,
+        .usage = run->usage,
+    };
+    for (int i = 0; i < nreporters; ++i) {
+        if (reporters[i].on_test_end) {
+            reporters[i].on_test_end(reporters[i].data, &result);
+        }
+    }
+}
+
+static void
+report_end(const RunSummary *summary) {
+    for (int i = 0; i < nreporters; ++i) {
+        if (reporters[i].on_run_end) {
+            reporters[i].on_run_end(reporters[i].data, summary);
+        }
+    }
+}
+
+// Buffered output of a reporter, lines being put together with plain copies. Whatever is written
+// out goes through the FILE right away: forked children get a copy of this buffer but, unlike a
+// FILE's own, never write it out a second time.
+typedef struct Output {
+    FILE *file;
+    size_t len;
+    char buf[REPORT_BUF_SIZE];
+} Output;
+
+static void
+out_flush(Output *out) {
+    if (out->len > 0) {
+        fwrite(out->buf, 1, out->len, out->file);
+        out->len = 0;
+    }
+    fflush(out->file);
+}
+
+static void
+out_write(Output *out, const char *s, size_t len) {
+    if (out->len + len > REPORT_BUF_SIZE) {
+        out_flush(out);
+        if (len > REPORT_BUF_SIZE) {
+            fwrite(s, 1, len, out->file);
+            fflush(out->file);
+            return;
+        }
+    }
+    memcpy(out->buf + out->len, s, len);
+    out->len += len;
+}
+
+static inline void
+out_puts(Output *out, const char *s) {
+    out_write(out, s, strlen(s));
+}
+
+// At most `max` characters of `s`, all of it if `max` is negative.
+static void
+out_cut(Output *out, const char *s, int max) {
+    size_t len = strlen(s);
+    out_write(out, s, max >= 0 && len > (size_t)max ? (size_t)max : len);
+}
+
+// `count` times `c`, if `count` is positive.
+static void
+out_fill(Output *out, char c, int count) {
+    while (count > 0) {
+        if (out->len == REPORT_BUF_SIZE) {
+            out_flush(out);
+        }
+        size_t room = REPORT_BUF_SIZE - out->len;
+        size_t n = (size_t)count < room ? (size_t)count : room;
+        memset(out->buf + out->len, c, n);
+        out->len += n;
+        count -= n;
+    }
+}
+
+static void
+out_long(Output *out, long value) {
+    char digits[24];
+    size_t start = sizeof(digits);
+    unsigned long rest = value < 0 ? -(unsigned long)value : (unsigned long)value;
+    do {
+        digits[--start] = '0' + rest % 10;
+        rest /= 10;
+    } while (rest > 0);
+    if (value < 0) {
+        digits[--start] = '-';
+    }
+    out_write(out, digits + start, sizeof(digits) - start);
+}
+
+static void
+out_printf(Output *out, const char *fmt, ...) PRINTF(2);
+
+static void
+out_printf(Output *out, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    size_t room = REPORT_BUF_SIZE - out->len;
+    int len = vsnprintf(out->buf + out->len, room, fmt, args);
+    va_end(args);
+    if (len < 0) {
+        return;
+    }
+    if ((size_t)len < room) {
+        out->len += len;
+        return;
+    }
+    out_flush(out);
+    va_start(args, fmt);
+    vfprintf(out->file, fmt, args);
+    va_end(args);
+    fflush(out->file);
+}
+
+// Console reporter, on stdout. The runner flushes it after every round of results, so they show
+// up as they are known and memory doesn't grow with the size of the run. The layout is worked
+// out once.
+// Quiet (SOUFFLE_QUIET=1) leaves out the tests that passed.
+typedef struct Console {
+    const RunList *list;
+    int max_cols;
+    bool quiet;
+    const char *prev_suite;
+    Output out;
+} Console;
+
+static bool
+quiet_mode() {
+    const char *quiet = getenv("SOUFFLE_QUIET");
+    return quiet && strcmp(quiet, "1") == 0;
+}
+
+static void
+console_rule(Console *con) {
+    out_cut(&con->out, DASHES, con->max_cols);
+    out_puts(&con->out, "\n");
+}
+
+// "Running N tests in M suites", with what was left out.
+static void
+console_selection(Console *con, const RunList *list) {
+    out_printf(&con->out, "Running %zu tests in %d suites", list->len, list->suites);
+    if (list->selected < tcount) {
+        out_printf(&con->out, " (%zu filtered out)", tcount - list->selected);
+    }
+    if (list->shard.count > 1) {
+        out_printf(&con->out, " (shard %ld of %ld, %zu tests on other shards)", list->shard.index,
+                   list->shard.count, list->selected - list->len);
+    }
+    out_printf(&con->out, "\n");
+}
+
+static void
+console_start(void *data, [[maybe_unused]] size_t ntests) {
+    Console *con = data;
+    out_puts(&con->out, "=== Test Run Started ===\n");
+    console_rule(con);
+    out_puts(&con->out, "\n");
+    console_selection(con, con->list);
+    console_rule(con);
+    out_puts(&con->out, "\n");
+    out_flush(&con->out);
+}
+
+static void
+console_test(void *data, const TestResult *result) {
+    Console *con = data;
+    if (con->quiet && result->status == Success) {
+        return;
+    }
+    if (con->prev_suite != result->suite) {
+        con->prev_suite = result->suite;
+        out_puts(&con->out, "⣿ Suite: ");
+        out_cut(&con->out, result->suite, con->max_cols - 11);
+        out_puts(&con->out, " ");
+        out_fill(&con->out, ' ', con->max_cols - 11 - (int)strlen(result->suite));
+        out_puts(&con->out, "⣿\n");
+    }
+    const Test *test = result->test;
+    out_puts(&con->out, test->setup ? "  ⚙ 🧪 " : "    🧪 ");
+    out_cut(&con->out, result->name, con->max_cols - 28);
+    out_puts(&con->out, " ......");
+    out_fill(&con->out, '.', con->max_cols - (int)strlen(result->name) - 28);
+    switch (result->status) {
+    case Success:
+        if (result->cached) {
+            out_puts(&con->out, " " GREEN "[PASSED, cached]" RESET "\n");
+            break;
+        }
+        out_puts(&con->out, " " GREEN "[PASSED, ");
+        out_long(&con->out, result->elapsed_ms);
+        out_puts(&con->out, "ms]" RESET "\n");
+        break;
+    case Fail:
+        out_puts(&con->out, " " RED "[FAILED, ");
+        out_long(&con->out, result->elapsed_ms);
+        out_puts(&con->out, "ms]" RESET "\n");
+        break;
+    case Skip:
+        out_puts(&con->out, " " YELLOW "[SKIPPED, ⏭ ]" RESET "\n");
+        break;
+    case Timeout:
+        out_puts(&con->out, " " GREY "[TIMEOUT, ⧖ ]" RESET "\n");
+        break;
+    case Crashed:
+        out_puts(&con->out, " " MAGENTA "[CRASHED, ☠ ]" RESET "\n\n");
+        return;
+    case Regressed:
+        out_puts(&con->out, " " RED "[REGRESSED, ");
+        out_long(&con->out, result->elapsed_ms);
+        out_puts(&con->out, "ms]" RESET "\n");
+        break;
+    default:
+        __builtin_unreachable();
+    };
+    for (size_t i = 0; i < result->nperf; ++i) {
+        out_puts(&con->out, i == 0 ? "\t  " : " | ");
+        out_printf(&con->out, "%ju %s", (uintmax_t)result->perf[i].value, result->perf[i].event);
+    }
+    if (result->nperf > 0) {
+        out_puts(&con->out, "\n");
+    }
+    if (result->msg) {
+        out_puts(&con->out, result->msg);
+    }
+    if (result->truncated) {
+        out_puts(&con->out, "\t  (log truncated)\n");
+    }
+    out_puts(&con->out, "\n");
+}
+
+static void
+console_end(void *data, const RunSummary *summary) {
+    Console *con = data;
+    const int *counts = summary->counts;
+    console_rule(con);
+    out_puts(&con->out, "\n=== Test Run Summary ===\n");
+    if (con->list->shard.count > 1) {
+        out_printf(&con->out, "Shard %ld of %ld\n", con->list->shard.index, con->list->shard.count);
+    }
+    out_printf(&con->out,
+               "Total Tests: %zu | " GREEN "Passed" RESET ": %d | " RED "Failed" RESET
+               ": %d | " MAGENTA "Crashed" RESET ": %d | " YELLOW "Skipped" RESET ": %d | " GREY
+               "Timeout" RESET ": %d\n",
+               summary->tests, counts[Success], counts[Fail], counts[Crashed], counts[Skip],
+               counts[Timeout]);
+    if (counts[Regressed] > 0 || bench_mode()) {
+        out_printf(&con->out, RED "Regressed" RESET ": %d\n", counts[Regressed]);
+    }
+    if (summary->cached > 0) {
+        out_printf(&con->out, "Cached: %zu passed last time in this binary, not run again\n",
+                   summary->cached);
+    }
+    if (summary->not_run > 0) {
+        out_printf(&con->out, RED "Stopped after %d failures" RESET ": %zu tests never run\n",
+                   failed_count(counts), summary->not_run);
+    }
+    console_rule(con);
+    out_flush(&con->out);
+}
+
+// `cols` is the width of the terminal.
+static void
+console_register(Console *con, int cols, const RunList *list) {
+    int max_cols = cols > 53 ? 53 : cols;
+    con->max_cols =
+        largest_name < max_cols ? max_cols : (largest_name > cols - 4 ? cols - 4 : largest_name);
+    con->list = list;
+    con->quiet = quiet_mode();
+    con->prev_suite = NULL;
+    con->out.file = stdout;
+    con->out.len = 0;
+    register_reporter((TestReporter){
+        .on_run_start = console_start,
+        .on_test_end = console_test,
+        .on_run_end = console_end,
+        .data = con,
+    });
+}
+
+// SOUFFLE_REPORT files, written as the results come in.
+typedef enum ReportFormat {
+    FormatJunit,
+    FormatTap,
+    FormatJsonl,
+} ReportFormat;
+
+typedef struct ReportFile {
+    ReportFormat format;
+    // TAP test number.
+    size_t tests;
+    // JUnit: where the totals of the whole run and of the open suite go once they are known, -1
+    // when the file can't seek (then there are no totals).
+    long run_totals;
+    long suite_totals;
+    int suite_counts[Regressed + 1];
+    bool in_suite;
+    Output out;
+} ReportFile;
+
+static const char *
+status_name(enum Status status) {
+    switch (status) {
+    case Success:
+        return "passed";
+    case Fail:
+        return "failed";
+    case Skip:
+        return "skipped";
+    case Timeout:
+        return "timeout";
+    case Crashed:
+        return "crashed";
+    case Regressed:
+        return "regressed";
+    default:
+        __builtin_unreachable();
+    }
+}
+
+typedef enum TextEscape {
+    EscapeXml,
+    EscapeJson,
+    // a YAML block scalar: every line indented.
+    EscapeYaml,
+} TextEscape;
+
+// Write `s` to a report file, escaped for its format and without the console's color codes.
+static void
+write_escaped(Output *out, const char *s, TextEscape escape) {
+    const char *span = s;
+    for (; *s; ++s) {
+        char code[8] = "";
+        if (*s == '\033' && s[1] == '[') {
+            // CSI sequence: parameters up to a final byte in @..~.
+            out_write(out, span, s - span);
+            s += 2;
+            while (*s && (*s < '@' || *s > '~')) {
+                s++;
+            }
+            if (*s == '\0') {
+                return;
+            }
+            span = s + 1;
+            continue;
+        }
+        unsigned char c = *s;
+        if (escape == EscapeXml) {
+            if (c == '&') {
+                strcpy(code, "&amp;");
+            } else if (c == '<') {
+                strcpy(code, "&lt;");
+            } else if (c == '>') {
+                strcpy(code, "&gt;");
+            } else if (c == '"') {
+                strcpy(code, "&quot;");
+            } else if (c < 0x20 && c != '\n' && c != '\t') {
+                // not allowed in XML 1.0 at all.
+                strcpy(code, "?");
+            }
+        } else if (escape == EscapeJson) {
+            if (c == '"' || c == '\\') {
+                snprintf(code, sizeof(code), "\\%c", c);
+            } else if (c == '\n') {
+                strcpy(code, "\\n");
+            } else if (c == '\t') {
+                strcpy(code, "\\t");
+            } else if (c < 0x20) {
+                snprintf(code, sizeof(code), "\\u%04x", c);
+            }
+        } else if (c == '\n' && s[1] != '\0') {
+            strcpy(code, "\n    ");
+        }
+        if (code[0]) {
+            out_write(out, span, s - span);
+            out_puts(out, code);
+            span = s + 1;
+        }
+    }
+    out_write(out, span, s - span);
+}
+
+// JUnit totals, fixed width so they can be written over once known.
+static void
+junit_totals(Output *out, const int *counts) {
+    int tests = 0;
+    for (int status = Success; status <= Regressed; ++status) {
+        tests += counts[status];
+    }
+    out_printf(out, " tests=\"%010d\" failures=\"%010d\" errors=\"%010d\" skipped=\"%010d\"",
+               tests, counts[Fail] + counts[Regressed], counts[Crashed] + counts[Timeout],
+               counts[Skip]);
+}
+
+// Leave room for the totals at the current position, returns where they go.
+static long
+junit_reserve(Output *out) {
+    out_flush(out);
+    long at = ftell(out->file);
+    if (at >= 0) {
+        int none[Regressed + 1] = {0};
+        junit_totals(out, none);
+    }
+    return at;
+}
+
+static void
+junit_patch(Output *out, long at, const int *counts) {
+    out_flush(out);
+    if (at >= 0 && fseek(out->file, at, SEEK_SET) == 0) {
+        junit_totals(out, counts);
+        out_flush(out);
+        fseek(out->file, 0, SEEK_END);
+    }
+}
+
+static void
+junit_close_suite(ReportFile *report) {
+    if (report->in_suite) {
+        out_puts(&report->out, "  </testsuite>\n");
+        junit_patch(&report->out, report->suite_totals, report->suite_counts);
+        report->in_suite = false;
+    }
+}
+
+static void
+report_file_start(void *data, size_t ntests) {
+    ReportFile *report = data;
+    Output *out = &report->out;
+    switch (report->format) {
+    case FormatJunit:
+        out_puts(out, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<testsuites");
+        report->run_totals = junit_reserve(out);
+        out_puts(out, ">\n");
+        break;
+    case FormatTap:
+        out_printf(out, "TAP version 13\n1..%zu\n", ntests);
+        break;
+    case FormatJsonl:
+        out_printf(out, "{\"type\":\"run_start\",\"tests\":%zu}\n", ntests);
+        break;
+    }
+}
+
+static void
+report_file_suite(void *data, const char *suite) {
+    ReportFile *report = data;
+    Output *out = &report->out;
+    switch (report->format) {
+    case FormatJunit:
+        junit_close_suite(report);
+        out_puts(out, "  <testsuite name=\"");
+        write_escaped(out, suite, EscapeXml);
+        out_puts(out, "\"");
+        report->suite_totals = junit_reserve(out);
+        out_puts(out, ">\n");
+        memset(report->suite_counts, 0, sizeof(report->suite_counts));
+        report->in_suite = true;
+        break;
+    case FormatTap:
+        out_printf(out, "# Suite: %s\n", suite);
+        break;
+    case FormatJsonl:
+        out_puts(out, "{\"type\":\"suite_start\",\"suite\":\"");
+        write_escaped(out, suite, EscapeJson);
+        out_puts(out, "\"}\n");
+        break;
+    }
+}
+
+static void
+junit_test(ReportFile *report, const TestResult *result) {
+    Output *out = &report->out;
+    report->suite_counts[result->status] += 1;
+    out_puts(out, "    <testcase classname=\"");
+    write_escaped(out, result->suite, EscapeXml);
+    out_puts(out, "\" name=\"");
+    write_escaped(out, result->name, EscapeXml);
+    out_printf(out, "\" time=\"%ld.%03ld\"", result->elapsed_ms / 1000, result->elapsed_ms % 1000);
+    if (result->status == Success && result->msg == NULL) {
+        out_puts(out, "/>\n");
+        return;
+    }
+    out_puts(out, ">\n");
+    const char *log_tag = "system-out";
+    switch (result->status) {
+    case Fail:
+        out_puts(out, "      <failure message=\"failed\">");
+        log_tag = NULL;
+        break;
+    case Regressed:
+        out_puts(out, "      <failure message=\"regressed\">");
+        log_tag = NULL;
+        break;
+    case Skip:
+        out_puts(out, "      <skipped/>\n");
+        break;
+    case Timeout:
+        out_puts(out, "      <error message=\"timed out\"/>\n");
+        break;
+    case Crashed:
+        out_puts(out, "      <error message=\"crashed\"/>\n");
+        break;
+    default:
+        break;
+    }
+    if (log_tag && result->msg) {
+        out_printf(out, "      <%s>", log_tag);
+    }
+    if (result->msg) {
+        write_escaped(out, result->msg, EscapeXml);
+    }
+    if (log_tag == NULL) {
+        out_puts(out, "</failure>\n");
+    } else if (result->msg) {
+        out_printf(out, "</%s>\n", log_tag);
+    }
+    out_puts(out, "    </testcase>\n");
+}
+
+static void
+tap_test(ReportFile *report, const TestResult *result) {
+    Output *out = &report->out;
+    report->tests++;
+    bool failed = status_failed(result->status);
+    out_printf(out, "%s %zu - %s.%s", failed ? "not ok" : "ok", report->tests, result->suite,
+               result->name);
+    out_puts(out, result->status == Skip ? " # SKIP\n" : "\n");
+    if (failed) {
+        out_printf(out, "  ---\n  status: %s\n  duration_ms: %ld\n",
+                   status_name(result->status), result->elapsed_ms);
+        if (result->msg) {
+            out_puts(out, "  message: |\n    ");
+            write_escaped(out, result->msg, EscapeYaml);
+            size_t len = strlen(result->msg);
+            if (len == 0 || result->msg[len - 1] != '\n') {
+                out_puts(out, "\n");
+            }
+        }
+        out_puts(out, "  ...\n");
+    }
+}
+
+static void
+jsonl_test(ReportFile *report, const TestResult *result) {
+    Output *out = &report->out;
+    out_puts(out, "{\"type\":\"test\",\"suite\":\"");
+    write_escaped(out, result->suite, EscapeJson);
+    out_puts(out, "\",\"name\":\"");
+    write_escaped(out, result->name, EscapeJson);
+    out_printf(out, "\",\"status\":\"%s\",\"elapsed_ms\":%ld,\"cached\":%s,",
+               status_name(result->status), result->elapsed_ms, result->cached ? "true" : "false");
+    for (size_t i = 0; i < result->nperf; ++i) {
+        out_printf(out, "%s\"%s\":%ju", i == 0 ? "\"perf\":{" : ",", result->perf[i].event,
+                   (uintmax_t)result->perf[i].value);
+    }
+    out_puts(out, result->nperf > 0 ? "}," : "");
+    const ResourceUsage *usage = result->usage;
+    if (usage) {
+        out_printf(out,
+                   "\"usage\":{\"max_rss_kb\":%ld,\"user_us\":%ld,\"sys_us\":%ld,"
+                   "\"minor_faults\":%ld,\"major_faults\":%ld,\"voluntary_switches\":%ld,"
+                   "\"involuntary_switches\":%ld},",
+                   usage->max_rss_kb, usage->user_us, usage->sys_us, usage->minor_faults,
+                   usage->major_faults, usage->voluntary_switches, usage->involuntary_switches);
+    }
+    out_puts(out, "\"message\":");
+    if (result->msg) {
+        out_puts(out, "\"");
+        write_escaped(out, result->msg, EscapeJson);
+        out_puts(out, "\"}\n");
+    } else {
+        out_puts(out, "null}\n");
+    }
+}
+
+static void
+report_file_test(void *data, const TestResult *result) {
+    ReportFile *report = data;
+    switch (report->format) {
+    case FormatJunit:
+        junit_test(report, result);
+        break;
+    case FormatTap:
+        tap_test(report, result);
+        break;
+    case FormatJsonl:
+        jsonl_test(report, result);
+        break;
+    }
+}
+
+static void
+report_file_end(void *data, const RunSummary *summary) {
+    ReportFile *report = data;
+    Output *out = &report->out;
+    const int *counts = summary->counts;
+    switch (report->format) {
+    case FormatJunit:
+        junit_close_suite(report);
+        out_puts(out, "</testsuites>\n");
+        junit_patch(out, report->run_totals, counts);
+        break;
+    case FormatTap:
+        if (summary->not_run > 0) {
+            out_printf(out, "Bail out! SOUFFLE_FAIL_FAST: %zu tests never run\n",
+                       summary->not_run);
+        }
+        break;
+    case FormatJsonl:
+        out_printf(out,
+                   "{\"type\":\"run_end\",\"tests\":%zu,\"passed\":%d,\"failed\":%d,\"crashed\":%d,"
+                   "\"skipped\":%d,\"timeout\":%d,\"regressed\":%d,\"cached\":%zu,"
+                   "\"not_run\":%zu}\n",
+                   summary->tests, counts[Success], counts[Fail], counts[Crashed], counts[Skip],
+                   counts[Timeout], counts[Regressed], summary->cached, summary->not_run);
+        break;
+    }
+    out_flush(out);
+    fclose(out->file);
+    free(report);
+}
+
+// SOUFFLE_REPORT: comma separated "format:path", format being junit, tap or jsonl.
+static void
+report_files_register() {
+    const char *spec = getenv("SOUFFLE_REPORT");
+    while (spec && *spec) {
+        const char *end = strchr(spec, ',');
+        size_t len = end ? (size_t)(end - spec) : strlen(spec);
+        const char *colon = memchr(spec, ':', len);
+        if (colon == NULL || colon + 1 == spec + len) {
+            fprintf(stderr, "Invalid SOUFFLE_REPORT entry \"%.*s\", expected format:path\n",
+                    (int)len, spec);
+            exit(EXIT_FAILURE);
+        }
+        size_t format_len = colon - spec;
+        ReportFormat format;
+        if (format_len == 5 && strncmp(spec, "junit", 5) == 0) {
+            format = FormatJunit;
+        } else if (format_len == 3 && strncmp(spec, "tap", 3) == 0) {
+            format = FormatTap;
+        } else if (format_len == 5 && strncmp(spec, "jsonl", 5) == 0) {
+            format = FormatJsonl;
+        } else {
+            fprintf(stderr, "Unknown SOUFFLE_REPORT format \"%.*s\" (junit, tap or jsonl)\n",
+                    (int)format_len, spec);
+            exit(EXIT_FAILURE);
+        }
+        size_t path_len = len - format_len - 1;
+        char path[path_len + 1];
+        memcpy(path, colon + 1, path_len);
+        path[path_len] = '\0';
+        ReportFile *report = calloc(1, sizeof(ReportFile));
+        assert(report);
+        report->format = format;
+        report->out.file = fopen(path, "w");
+        if (report->out.file == NULL) {
+            perror(path);
+            exit(EXIT_FAILURE);
+        }
+        register_reporter((TestReporter){
+            .on_run_start = report_file_start,
+            .on_suite_start = report_file_suite,
+            .on_test_end = report_file_test,
+            .on_run_end = report_file_end,
+            .data = report,
+        });
+        spec = end ? end + 1 : NULL;
+    }
+}
+
+// --list / SOUFFLE_LIST=1: print the selected tests as "suite.name [tags]" without running them.
+static int
+list_tests() {
+    RunList list = select_runs();
+    for (size_t r = 0; r < list.len; ++r) {
+        const Test *test = list.runs[r].test;
+        if (test->options.tags) {
+            fprintf(stdout, "%s.%s [%s]\n", list.runs[r].suite, list.runs[r].name,
+                    test->options.tags);
+        } else {
+            fprintf(stdout, "%s.%s\n", list.runs[r].suite, list.runs[r].name);
+        }
+    }
+    runs_free(&list);
+    return 0;
+}
+
+#ifndef _WIN32
+// How long a test that ran out of time gets to handle SIGTERM before it is killed.
+#define KILL_GRACE_MS 100
+
+// Address space reserved per slot for the logs the runner hasn't taken yet. Only the pages logs
+// actually land on cost memory.
+#define LOG_REGION_SIZE ((size_t)1 << 28)
+#define LOG_REGION_MIN ((size_t)1 << 20)
+// How much of its region a slot may fill before it waits for the runner to take what is there. A
+// bigger log still gets the whole region once the runner has caught up.
+#define LOG_BACKLOG ((size_t)1 << 24)
+
+#ifndef MAP_NORESERVE
+#define MAP_NORESERVE 0
+#endif
+
+typedef enum ResultState {
+    ResultPending,
+    ResultStarted,
+    // written by the test's own process, its worker has yet to add what wait4 says it used.
+    ResultWritten,
+    ResultDone,
+} ResultState;
+
+// The result of one run, written by whichever process ran the test. The other fields are only
+// meaningful once `state` reads ResultDone; `pid` is set from ResultStarted on.
+typedef struct SharedResult {
+    _Atomic int state;
+    pid_t pid;
+    enum Status status;
+    long elapsed_ms;
+    size_t log_off;
+    size_t log_len;
+    // the region the log is in and its `written` count past the log, 0 if nothing was written.
+    int log_region;
+    size_t log_end;
+    bool truncated;
+    // SOUFFLE_PERF counts, perf_len of them.
+    bool has_perf;
+    uint64_t perf[PERF_MAX_EVENTS];
+    bool has_usage;
+    ResourceUsage usage;
+    // the worker that published this is leaving: it must not be handed another test.
+    bool retiring;
+} SharedResult;
+
+// The part of the log arena of one slot, written by one process at a time: its worker (and the
+// children the worker waits for) or its batch child. Logs are bump-allocated from `top`. The runner
+// copies each log out when it collects the result, so once it has taken all `written` bytes
+// (`freed` caught up) the region starts over.
+typedef struct LogRegion {
+    size_t top;
+    _Atomic size_t written;
+    _Atomic size_t freed;
+} LogRegion;
+
+// Mapped shared before the first fork: every child publishes its result and log straight into
+// the runner's memory, the logs of slot `s` going to `regions[s]`, at `logs + s * region_size`.
+typedef struct SharedArena {
+    size_t region_size;
+    char *logs;
+    int nregions;
+    LogRegion *regions;
+    SharedResult results[];
+} SharedArena;
+
+static SharedArena *arena;
+
+// The log region of this process, -1 in the runner.
+static int log_region = -1;
+
+// Runs that failed, crashed or timed out so far.
+static size_t failures = 0;
+
+// Self-pipe the runner sleeps on. It rings when a child exits (SIGCHLD) and when a result is
+// published by a process that isn't the runner's child.
+static int doorbell[2] = {-1, -1};
+
+// How tests get their own process:
+// - ModeIsolated: the runner forks long-lived workers that vfork one child per test.
+// - ModeServer: the runner forks long-lived workers that fork one child per test.
+// - ModeBatch: the runner forks one child per suite that runs the tests in-process.
+typedef enum ExecMode {
+    ModeIsolated,
+    ModeServer,
+    ModeBatch,
+} ExecMode;
+
+// A running child process. A `server` slot holds a worker, fed run indices through `cmd`,
+// otherwise a batch child.
+// A `zygote` is a worker for one suite with fixtures: it owns the runs [next, end) and is retired
+// (`draining`) once they have all been dispatched.
+// A `batch` child runs [next, end) by itself, `next` being the test it is currently running.
+//
+// The runner supervises the test in progress: `target` is the process running it, 0 for a
+// worker's test, run by a child it made for it. Once `deadline` passes it gets
+// SIGTERM, then SIGKILL.
+typedef struct Slot {
+    pid_t pid;
+    int cmd;
+    bool server;
+    bool zygote;
+    bool batch;
+    bool busy;
+    bool draining;
+    size_t run;
+    size_t next;
+    size_t end;
+    struct timespec start;
+    pid_t target;
+    int64_t deadline;
+    int kills;
+    bool timed_out;
+} Slot;
+
+// SOUFFLE_RERUN, what to do with the results the history kept:
+// - RerunFailedFirst: run the tests that failed, crashed or timed out last time first.
+// - RerunOnlyFailed: also skip the tests that passed last time in the same binary.
+typedef enum RerunMode {
+    RerunAll,
+    RerunFailedFirst,
+    RerunOnlyFailed,
+} RerunMode;
+
+// Runner-wide settings, read once from the environment.
+typedef struct RunConfig {
+    int jobs;
+    ExecMode mode;
+    long timeout_ms;
+    const char *history;
+    RerunMode rerun;
+    // identifies this binary, 0 if it can't be told apart from a rebuild.
+    uint64_t build_id;
+    long fail_fast;
+} RunConfig;
+
+// A piece of work handed to a slot as a whole: the runs [first, end), a whole suite when it runs
+// in a zygote or a batch child, a single test otherwise.
+typedef struct RunUnit {
+    size_t first;
+    size_t end;
+    bool failed_before;
+    bool known;
+    long expected_ms;
+} RunUnit;
+
+// SOUFFLE_JOBS: number of tests running at once, defaults to the number of online CPUs (1 for
+// benchmarks).
+static int
+jobs_count(size_t nruns) {
+    const char *jobs_str = getenv("SOUFFLE_JOBS");
+    long jobs = jobs_str ? atol(jobs_str) : 0;
+    if (jobs <= 0 && bench_mode()) {
+        // benchmarks running side by side would slow each other down.
+        jobs = 1;
+    }
+    if (jobs <= 0) {
+        jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if (jobs <= 0) {
+        jobs = 1;
+    }
+    if ((size_t)jobs > nruns) {
+        jobs = nruns > 0 ? nruns : 1;
+    }
+    return jobs;
+}
+
+// SOUFFLE_MODE: "server" to fork every test from a long-lived worker, "batch" to run each suite in
+// a single child.
+static ExecMode
+exec_mode() {
+    const char *mode_str = getenv("SOUFFLE_MODE");
+    if (mode_str && strcmp(mode_str, "server") == 0) {
+        return ModeServer;
+    }
+    if (mode_str && strcmp(mode_str, "batch") == 0) {
+        return ModeBatch;
+    }
+    return ModeIsolated;
+}
+
+// SOUFFLE_TIMEOUT: seconds, or milliseconds with an "ms" suffix ("200ms").
+static long
+default_timeout_ms() {
+    const char *timeout_str = getenv("SOUFFLE_TIMEOUT");
+    if (timeout_str == NULL) {
+        return 20000;
+    }
+    char *unit;
+    long timeout = strtol(timeout_str, &unit, 10);
+    if (timeout <= 0) {
+        return 20000;
+    }
+    return strcmp(unit, "ms") == 0 ? timeout : timeout * 1000;
+}
+
+// SOUFFLE_HISTORY: path of the timing history, NULL when there is none.
+static const char *
+history_path() {
+    const char *path = getenv("SOUFFLE_HISTORY");
+    return path && *path ? path : NULL;
+}
+
+static RerunMode
+rerun_mode() {
+    const char *rerun_str = getenv("SOUFFLE_RERUN");
+    if (rerun_str && strcmp(rerun_str, "failed-first") == 0) {
+        return RerunFailedFirst;
+    }
+    if (rerun_str && strcmp(rerun_str, "only-failed") == 0) {
+        return RerunOnlyFailed;
+    }
+    return RerunAll;
+}
+
+static int64_t
+monotonic_ms() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+static long
+elapsed_since(const struct timespec *start) {
+    struct timespec end;
+    timespec_get(&end, TIME_UTC);
+    return (end.tv_sec - start->tv_sec) * 1000 + (end.tv_nsec - start->tv_nsec) / 1000000;
+}
+
+static enum Status
+status_from_wait(int status) {
+    if (WIFEXITED(status) && (WEXITSTATUS(status) < Crashed || WEXITSTATUS(status) == Regressed)) {
+        return (enum Status)WEXITSTATUS(status);
+    }
+    return Crashed;
+}
+
+static bool
+write_full(int fd, const void *buf, size_t len) {
+    size_t written = 0;
+    while (written < len) {
+        ssize_t wret = write(fd, (const char *)buf + written, len - written);
+        if (wret == -1 && errno == EINTR) {
+            continue;
+        }
+        if (wret == -1) {
+            return false;
+        }
+        written += wret;
+    }
+    return true;
+}
+
+static bool
+read_full(int fd, void *buf, size_t len) {
+    size_t got = 0;
+    while (got < len) {
+        ssize_t rret = read(fd, (char *)buf + got, len - got);
+        if (rret == -1 && errno == EINTR) {
+            continue;
+        }
+        if (rret <= 0) {
+            return false;
+        }
+        got += rret;
+    }
+    return true;
+}
+
+// SOUFFLE_HISTORY: a file recording how each test did over its last runs. It is a hash table of
+// fixed-size entries keyed by a hash of "suite.name": read once before the run to schedule the
+// longest (or last failed) tests first, derive per-test timeouts and skip cached passes, updated
+// in place once it is over.
+#define HISTORY_MAGIC 0x48464c53u
+#define HISTORY_VERSION 2
+#define HISTORY_SAMPLES 8
+#define HISTORY_MIN_CAPACITY 1024
+// A test seen at least HISTORY_MIN_SAMPLES times times out after HISTORY_TIMEOUT_FACTOR times its
+// slowest recent run (no less than HISTORY_TIMEOUT_MIN_MS), unless SOUFFLE_TIMEOUT is shorter.
+#define HISTORY_MIN_SAMPLES 3
+#define HISTORY_TIMEOUT_FACTOR 5
+#define HISTORY_TIMEOUT_MIN_MS 1000
+
+typedef struct HistoryHeader {
+    uint32_t magic;
+    uint32_t version;
+    // a power of two.
+    uint64_t capacity;
+    uint64_t count;
+} HistoryHeader;
+
+// `duration_ms` is a ring of the last runs that passed or failed, the next one going to
+// `samples % HISTORY_SAMPLES`. `last_status` is how the test ended last time, in the binary
+// identified by `build_id`. A zero `key` marks a free entry.
+typedef struct HistoryEntry {
+    uint64_t key;
+    uint64_t build_id;
+    uint32_t samples;
+    uint32_t last_status;
+    uint32_t duration_ms[HISTORY_SAMPLES];
+} HistoryEntry;
+
+// FNV-1a of "suite.name", never 0.
+static uint64_t
+history_key(const char *suite, const char *name) {
+    uint64_t hash = fnv1a(FNV_OFFSET, suite, strlen(suite));
+    hash = fnv1a(hash, ".", 1);
+    hash = fnv1a(hash, name, strlen(name));
+    return hash ? hash : 1;
+}
+
+#ifdef __linux__
+static int
+build_id_note(struct dl_phdr_info *info, size_t size, void *data) {
+    (void)size;
+    uint64_t *id = data;
+    for (int i = 0; i < info->dlpi_phnum; ++i) {
+        const ElfW(Phdr) *phdr = &info->dlpi_phdr[i];
+        if (phdr->p_type != PT_NOTE) {
+            continue;
+        }
+        const char *note = (const char *)(info->dlpi_addr + phdr->p_vaddr);
+        const char *end = note + phdr->p_memsz;
+        while (note + sizeof(ElfW(Nhdr)) <= end) {
+            const ElfW(Nhdr) *nhdr = (const ElfW(Nhdr) *)note;
+            const char *name = note + sizeof(ElfW(Nhdr));
+            const char *desc = name + ((nhdr->n_namesz + 3) & ~3u);
+            if (nhdr->n_type == NT_GNU_BUILD_ID && nhdr->n_namesz == 4 &&
+                memcmp(name, "GNU", 4) == 0) {
+                *id = fnv1a(FNV_OFFSET, desc, nhdr->n_descsz);
+                return 1;
+            }
+            note = desc + ((nhdr->n_descsz + 3) & ~3u);
+        }
+    }
+    // the executable comes first, that's the only one we care about.
+    return 1;
+}
+#endif
+
+// A hash of the executable's ELF build-id, 0 where there is none.
+static uint64_t
+build_id() {
+    uint64_t id = 0;
+#ifdef __linux__
+    dl_iterate_phdr(build_id_note, &id);
+#endif
+    return id;
+}
+
+static HistoryEntry *
+history_entries(HistoryHeader *header) {
+    return (HistoryEntry *)(header + 1);
+}
+
+// The entry of `key`, or the free entry it goes in (linear probing). NULL if the table is full.
+static HistoryEntry *
+history_find(HistoryHeader *header, uint64_t key) {
+    HistoryEntry *entries = history_entries(header);
+    uint64_t mask = header->capacity - 1;
+    for (uint64_t probe = 0; probe < header->capacity; ++probe) {
+        HistoryEntry *entry = &entries[(key + probe) & mask];
+        if (entry->key == 0 || entry->key == key) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+// Map the history file open at `fd`. NULL if it is empty or not a history file.
+static HistoryHeader *
+history_map(int fd, int prot, size_t *size) {
+    struct stat st;
+    if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(HistoryHeader)) {
+        return NULL;
+    }
+    HistoryHeader *header = mmap(NULL, st.st_size, prot, MAP_SHARED, fd, 0);
+    if (header == MAP_FAILED) {
+        return NULL;
+    }
+    uint64_t capacity = header->capacity;
+    if (header->magic != HISTORY_MAGIC || header->version != HISTORY_VERSION || capacity == 0 ||
+        (capacity & (capacity - 1)) != 0 ||
+        sizeof(HistoryHeader) + capacity * sizeof(HistoryEntry) != (size_t)st.st_size) {
+        munmap(header, st.st_size);
+        return NULL;
+    }
+    *size = st.st_size;
+    return header;
+}
+
+// Whether the file open at `fd`, which history_map() refused, can be started over: it is empty, or
+// it is a history of another version (or a damaged one). Anything else is not ours to overwrite.
+static bool
+history_replaceable(int fd) {
+    struct stat st;
+    uint32_t magic;
+    if (fstat(fd, &st) == -1) {
+        return false;
+    }
+    return st.st_size == 0 ||
+           (pread(fd, &magic, sizeof(magic), 0) == sizeof(magic) && magic == HISTORY_MAGIC);
+}
+
+// Resize the file to hold `needed` entries at most 3/4 full and rehash what `old` held into it.
+static HistoryHeader *
+history_grow(int fd, HistoryHeader *old, size_t *size, uint64_t needed) {
+    uint64_t capacity = HISTORY_MIN_CAPACITY;
+    while (needed * 4 > capacity * 3) {
+        capacity *= 2;
+    }
+    // keep the old entries aside while the file is resized under them.
+    HistoryEntry *kept = NULL;
+    size_t nkept = 0;
+    if (old) {
+        kept = malloc(old->capacity * sizeof(HistoryEntry));
+        assert(kept);
+        for (uint64_t i = 0; i < old->capacity; ++i) {
+            if (history_entries(old)[i].key) {
+                kept[nkept++] = history_entries(old)[i];
+            }
+        }
+        munmap(old, *size);
+    }
+    *size = sizeof(HistoryHeader) + capacity * sizeof(HistoryEntry);
+    HistoryHeader *header = MAP_FAILED;
+    if (ftruncate(fd, 0) == 0 && ftruncate(fd, *size) == 0) {
+        header = mmap(NULL, *size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    if (header == MAP_FAILED) {
+        perror("Failed to resize the history");
+        free(kept);
+        return NULL;
+    }
+    *header = (HistoryHeader){
+        .magic = HISTORY_MAGIC,
+        .version = HISTORY_VERSION,
+        .capacity = capacity,
+        .count = nkept,
+    };
+    for (size_t i = 0; i < nkept; ++i) {
+        *history_find(header, kept[i].key) = kept[i];
+    }
+    free(kept);
+    return header;
+}
+
+// What the history knows about each run: its mean recent duration, a timeout derived from its
+// slowest recent run and whether it failed last time. With SOUFFLE_RERUN=only-failed, a test that
+// passed last time in this very binary is done already.
+static void
+history_load(TestRun *runs, size_t nruns, const RunConfig *config) {
+    int fd = open(config->history, O_RDONLY);
+    if (fd == -1) {
+        // nothing recorded yet.
+        return;
+    }
+    flock(fd, LOCK_SH);
+    size_t size;
+    HistoryHeader *header = history_map(fd, PROT_READ, &size);
+    for (size_t r = 0; header && r < nruns; ++r) {
+        const HistoryEntry *entry =
+            history_find(header, history_key(runs[r].suite, runs[r].name));
+        if (entry == NULL || entry->key == 0) {
+            continue;
+        }
+        uint32_t n = entry->samples < HISTORY_SAMPLES ? entry->samples : HISTORY_SAMPLES;
+        uint64_t sum = 0;
+        uint32_t slowest = 0;
+        for (uint32_t i = 0; i < n; ++i) {
+            sum += entry->duration_ms[i];
+            slowest = entry->duration_ms[i] > slowest ? entry->duration_ms[i] : slowest;
+        }
+        runs[r].known = n > 0;
+        runs[r].expected_ms = n > 0 ? sum / n : 0;
+        runs[r].failed_before = config->rerun != RerunAll && status_failed(entry->last_status);
+        if (config->rerun == RerunOnlyFailed && entry->last_status == Success &&
+            config->build_id != 0 && entry->build_id == config->build_id) {
+            runs[r].cached = true;
+            runs[r].status = Success;
+            runs[r].done = true;
+        }
+        if (entry->samples >= HISTORY_MIN_SAMPLES) {
+            long timeout_ms = (long)slowest * HISTORY_TIMEOUT_FACTOR;
+            runs[r].history_timeout_ms =
+                timeout_ms > HISTORY_TIMEOUT_MIN_MS ? timeout_ms : HISTORY_TIMEOUT_MIN_MS;
+        }
+    }
+    if (header) {
+        munmap(header, size);
+    }
+    close(fd);
+}
+
+static void
+history_weigh(TestRun *runs, size_t nruns) {
+    RunConfig config = {.history = history_path(), .rerun = RerunAll};
+    if (config.history) {
+        history_load(runs, nruns, &config);
+    }
+}
+
+static bool
+history_records(const TestRun *run) {
+    return run->done && !run->cached;
+}
+
+// Record how every test that ran ended, and the duration of those that passed or failed. Only the
+// entries of those tests are touched, unless the table has to grow to take new ones.
+static void
+history_save(const TestRun *runs, size_t nruns, const RunConfig *config) {
+    int fd = open(config->history, O_RDWR | O_CREAT, 0644);
+    if (fd == -1) {
+        perror("Failed to open the history");
+        return;
+    }
+    flock(fd, LOCK_EX);
+    size_t size = 0;
+    HistoryHeader *header = history_map(fd, PROT_READ | PROT_WRITE, &size);
+    if (header == NULL && !history_replaceable(fd)) {
+        fprintf(stderr, "%s is not a timing history, not saving over it\n", config->history);
+        close(fd);
+        return;
+    }
+    uint64_t added = 0;
+    for (size_t r = 0; r < nruns; ++r) {
+        if (history_records(&runs[r])) {
+            HistoryEntry *entry =
+                header ? history_find(header, history_key(runs[r].suite, runs[r].name))
+                       : NULL;
+            added += entry == NULL || entry->key == 0;
+        }
+    }
+    uint64_t count = header ? header->count : 0;
+    if (header == NULL || (count + added) * 4 > header->capacity * 3) {
+        header = history_grow(fd, header, &size, count + added);
+    }
+    for (size_t r = 0; header && r < nruns; ++r) {
+        if (!history_records(&runs[r])) {
+            continue;
+        }
+        uint64_t key = history_key(runs[r].suite, runs[r].name);
+        HistoryEntry *entry = history_find(header, key);
+        if (entry == NULL) {
+            continue;
+        }
+        if (entry->key == 0) {
+            *entry = (HistoryEntry){.key = key};
+            header->count++;
+        }
+        entry->build_id = config->build_id;
+        entry->last_status = runs[r].status;
+        if (runs[r].status != Success && runs[r].status != Fail) {
+            continue;
+        }
+        long elapsed_ms = runs[r].elapsed_ms > 0 ? runs[r].elapsed_ms : 0;
+        entry->duration_ms[entry->samples % HISTORY_SAMPLES] =
+            elapsed_ms < UINT32_MAX ? elapsed_ms : UINT32_MAX;
+        entry->samples++;
+    }
+    if (header) {
+        munmap(header, size);
+    }
+    close(fd);
+}
+
+static size_t
+arena_size(size_t nruns, int jobs) {
+    return sizeof(SharedArena) + nruns * sizeof(SharedResult) + jobs * sizeof(LogRegion);
+}
+
+static void
+arena_init(size_t nruns, int jobs) {
+    size_t size = arena_size(nruns, jobs);
+    arena = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (arena == MAP_FAILED) {
+        perror("Failed to map the result arena");
+        exit(EXIT_FAILURE);
+    }
+    // without overcommit the reservation has to be backed, so settle for less.
+    size_t region_size = LOG_REGION_SIZE;
+    char *logs;
+    while ((logs = mmap(NULL, region_size * jobs, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0)) == MAP_FAILED &&
+           region_size > LOG_REGION_MIN) {
+        region_size /= 2;
+    }
+    if (logs == MAP_FAILED) {
+        perror("Failed to map the log arena");
+        exit(EXIT_FAILURE);
+    }
+    arena->logs = logs;
+    arena->region_size = region_size;
+    arena->nregions = jobs;
+    arena->regions = (LogRegion *)&arena->results[nruns];
+}
+
+static void
+arena_free(size_t nruns) {
+    munmap(arena->logs, arena->region_size * arena->nregions);
+    munmap(arena, arena_size(nruns, arena->nregions));
+    arena = NULL;
+}
+
+static void
+doorbell_ring() {
+    char bell = 0;
+    // a full pipe already wakes the runner.
+    (void)!write(doorbell[1], &bell, 1);
+}
+
+static void
+doorbell_drain() {
+    char bells[256];
+    while (read(doorbell[0], bells, sizeof(bells)) > 0) {
+    }
+}
+
+static void
+on_child_exit(int sig) {
+    (void)sig;
+    int saved_errno = errno;
+    doorbell_ring();
+    errno = saved_errno;
+}
+
+// Children get the default dispositions back: the runner ignores SIGPIPE and rings on SIGCHLD.
+static void
+child_signals() {
+    signal(SIGPIPE, SIG_DFL);
+    signal(SIGCHLD, SIG_DFL);
+}
+
+static bool
+result_done(size_t run) {
+    return atomic_load_explicit(&arena->results[run].state, memory_order_acquire) == ResultDone;
+}
+
+// Called by a worker once it forked the child running `run`.
+static void
+result_start(size_t run, pid_t pid) {
+    arena->results[run].pid = pid;
+    atomic_store_explicit(&arena->results[run].state, ResultStarted, memory_order_release);
+}
+
+// The process a worker forked for `run`, 0 if it has none (yet, or any more).
+static pid_t
+result_pid(size_t run) {
+    int state = atomic_load_explicit(&arena->results[run].state, memory_order_acquire);
+    return state == ResultStarted || state == ResultWritten ? arena->results[run].pid : 0;
+}
+
+// Room for `len` bytes in this process's log region, waiting for the runner to take what is in the
+// way if `wait`. Returns how many bytes fit.
+static size_t
+log_reserve(LogRegion *region, size_t len, bool wait) {
+    size_t size = arena->region_size;
+    size_t backlog = LOG_BACKLOG < size ? LOG_BACKLOG : size;
+    bool empty = atomic_load_explicit(&region->freed, memory_order_acquire) ==
+                 atomic_load_explicit(&region->written, memory_order_relaxed);
+    if (empty) {
+        region->top = 0;
+    }
+    while (!empty && wait && region->top + len > backlog) {
+        // the runner is woken by every result it is given, so this doesn't last.
+        nanosleep(&(struct timespec){.tv_nsec = 100000}, NULL);
+        empty = atomic_load_explicit(&region->freed, memory_order_acquire) ==
+                atomic_load_explicit(&region->written, memory_order_relaxed);
+        if (empty) {
+            region->top = 0;
+        }
+    }
+    return region->top + len <= size ? len : size - region->top;
+}
+
+// Copy a log into the log region of this process. A log is only cut short when it is larger than
+// the region, or, unless `wait`, when it doesn't fit next to those the runner has yet to collect.
+static void
+result_log(SharedResult *result, const SouffleString *log, bool wait) {
+    size_t len = log ? log->len : 0;
+    result->log_len = 0;
+    result->truncated = false;
+    if (len == 0) {
+        return;
+    }
+    assert(log_region >= 0);
+    LogRegion *region = &arena->regions[log_region];
+    size_t room = log_reserve(region, len + 1, wait);
+    if (room == 0) {
+        result->truncated = true;
+        return;
+    }
+    if (len + 1 > room) {
+        len = room - 1;
+        result->truncated = true;
+    }
+    char *logs = arena->logs + log_region * arena->region_size;
+    memcpy(logs + region->top, log->buf, len);
+    logs[region->top + len] = '\0';
+    result->log_off = log_region * arena->region_size + region->top;
+    result->log_len = len;
+    result->log_region = log_region;
+    region->top += len + 1;
+    result->log_end = atomic_load_explicit(&region->written, memory_order_relaxed) + len + 1;
+    atomic_store_explicit(&region->written, result->log_end, memory_order_relaxed);
+}
+
+// Write the result of `run`, not yet telling the runner. `perf` is NULL when it wasn't measured.
+static void
+result_write(size_t run, enum Status status, long elapsed_ms, const SouffleString *log,
+             const uint64_t *perf) {
+    SharedResult *result = &arena->results[run];
+    result->has_perf = perf != NULL;
+    if (perf) {
+        memcpy(result->perf, perf, perf_len * sizeof(uint64_t));
+    }
+    result_log(result, log, true);
+    result->status = status;
+    result->elapsed_ms = elapsed_ms;
+}
+
+// Hand the written result of `run` over to the runner and wake it. `usage` is NULL when it
+// wasn't measured.
+static void
+result_publish(size_t run, const ResourceUsage *usage) {
+    SharedResult *result = &arena->results[run];
+    result->has_usage = usage != NULL;
+    if (usage) {
+        result->usage = *usage;
+    }
+    atomic_store_explicit(&result->state, ResultDone, memory_order_release);
+    doorbell_ring();
+}
+
+static void
+run_finish(TestRun *run, enum Status status, long elapsed_ms) {
+    run->status = status;
+    run->elapsed_ms = elapsed_ms;
+    run->done = true;
+    failures += status_failed(status);
+}
+
+// Take the published result of `runs[run]`. The log is copied out, giving its place in the log
+// region back: otherwise the region would only ever fill up, and cut the logs of a long run short.
+static void
+run_collect(TestRun *runs, size_t run) {
+    const SharedResult *result = &arena->results[run];
+    runs[run].msg = NULL;
+    if (result->log_len > 0) {
+        runs[run].msg = malloc(result->log_len + 1);
+        assert(runs[run].msg);
+        memcpy(runs[run].msg, arena->logs + result->log_off, result->log_len + 1);
+    }
+    if (result->log_end > 0) {
+        atomic_store_explicit(&arena->regions[result->log_region].freed, result->log_end,
+                              memory_order_release);
+    }
+    runs[run].truncated = result->truncated;
+    runs[run].perf = result->has_perf ? result->perf : NULL;
+    runs[run].usage = result->has_usage ? &result->usage : NULL;
+    run_finish(&runs[run], result->status, result->elapsed_ms);
+}
+
+// SOUFFLE_PERF: performance counters, opened by each test's process around its setup, test and
+// teardown.
+#ifdef __linux__
+typedef struct PerfEvent {
+    const char *name;
+    uint32_t type;
+    uint64_t config;
+} PerfEvent;
+
+static const PerfEvent PERF_EVENTS[] = {
+    {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {"cache-references", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES},
+    {"cache-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {"branches", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_INSTRUCTIONS},
+    {"branch-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {"task-clock", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK},
+    {"page-faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+    {"context-switches", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+    {"cpu-migrations", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_MIGRATIONS},
+};
+
+// Counted instead of the hardware events the kernel won't give us: no PMU (most VMs and
+// containers) or a perf_event_paranoid level that forbids them.
+static const char *const PERF_FALLBACK[] = {"task-clock", "page-faults", "context-switches"};
+
+static const PerfEvent *perf_events[PERF_MAX_EVENTS];
+// Only count user space, when perf_event_paranoid doesn't let us count the kernel.
+static bool perf_user_only = false;
+
+static const PerfEvent *
+perf_event(const char *name, size_t len) {
+    for (size_t i = 0; i < sizeof(PERF_EVENTS) / sizeof(PERF_EVENTS[0]); ++i) {
+        if (strlen(PERF_EVENTS[i].name) == len && strncmp(PERF_EVENTS[i].name, name, len) == 0) {
+            return &PERF_EVENTS[i];
+        }
+    }
+    return NULL;
+}
+
+static void
+perf_add(const PerfEvent *event) {
+    for (size_t i = 0; i < perf_len; ++i) {
+        if (perf_events[i] == event) {
+            return;
+        }
+    }
+    if (perf_len < PERF_MAX_EVENTS) {
+        perf_names[perf_len] = event->name;
+        perf_events[perf_len++] = event;
+    }
+}
+
+static int
+perf_event_fd(const PerfEvent *event, int group_fd) {
+    struct perf_event_attr attr = {
+        .size = sizeof(attr),
+        .type = event->type,
+        .config = event->config,
+        .disabled = group_fd == -1,
+        .exclude_kernel = perf_user_only,
+        .exclude_hv = perf_user_only,
+        .read_format =
+            PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING,
+    };
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, PERF_FLAG_FD_CLOEXEC);
+}
+
+// Whether the kernel lets this process count `event`, sets perf_user_only if it only does for
+// user space.
+static bool
+perf_probe(const PerfEvent *event) {
+    int fd = perf_event_fd(event, -1);
+    if (fd == -1 && errno == EACCES && !perf_user_only) {
+        perf_user_only = true;
+        fd = perf_event_fd(event, -1);
+        perf_user_only = fd != -1;
+    }
+    if (fd != -1) {
+        close(fd);
+    }
+    return fd != -1;
+}
+
+// Resolve SOUFFLE_PERF (comma separated events) into the events every test will count.
+static void
+perf_init() {
+    const char *events_str = getenv("SOUFFLE_PERF");
+    if (!events_str) {
+        return;
+    }
+    bool fallback = false;
+    int error = 0;
+    for (const char *name = events_str; *name;) {
+        size_t len = strcspn(name, ",");
+        const PerfEvent *event = perf_event(name, len);
+        if (!event) {
+            fprintf(stderr, "SOUFFLE_PERF: unknown event \"%.*s\"\n", (int)len, name);
+        } else if (perf_probe(event)) {
+            perf_add(event);
+        } else if (event->type == PERF_TYPE_HARDWARE) {
+            fallback = true;
+            error = errno;
+        } else {
+            fprintf(stderr, "SOUFFLE_PERF: cannot count %s: %s\n", event->name, strerror(errno));
+        }
+        name += name[len] == ',' ? len + 1 : len;
+    }
+    if (!fallback) {
+        return;
+    }
+    size_t before = perf_len;
+    for (size_t i = 0; i < sizeof(PERF_FALLBACK) / sizeof(PERF_FALLBACK[0]); ++i) {
+        const PerfEvent *event = perf_event(PERF_FALLBACK[i], strlen(PERF_FALLBACK[i]));
+        if (perf_probe(event)) {
+            perf_add(event);
+        }
+    }
+    fprintf(stderr, "SOUFFLE_PERF: hardware counters unavailable (%s), %s\n", strerror(error),
+            perf_len > before ? "counting software events instead" : "not counting them");
+}
+
+// The counters of one test, opened as a group so they are all scheduled at the same time.
+typedef struct PerfGroup {
+    int fds[PERF_MAX_EVENTS];
+    size_t len;
+} PerfGroup;
+
+static void
+perf_close(PerfGroup *group) {
+    for (size_t i = 0; i < group->len; ++i) {
+        close(group->fds[i]);
+    }
+    group->len = 0;
+}
+
+static bool
+perf_open(PerfGroup *group) {
+    group->len = 0;
+    for (size_t i = 0; i < perf_len; ++i) {
+        int fd = perf_event_fd(perf_events[i], i == 0 ? -1 : group->fds[0]);
+        if (fd == -1) {
+            perf_close(group);
+            return false;
+        }
+        group->fds[group->len++] = fd;
+    }
+    return group->len > 0;
+}
+
+static void
+perf_start(PerfGroup *group) {
+    ioctl(group->fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(group->fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+// Stop and close the group, `counts` gets its values. They are scaled up when the kernel had to
+// multiplex the counters (more groups than hardware counters), false if the group never ran.
+static bool
+perf_stop(PerfGroup *group, uint64_t *counts) {
+    ioctl(group->fds[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    // nr, time_enabled, time_running, then a value per counter.
+    uint64_t values[3 + PERF_MAX_EVENTS];
+    ssize_t len = read(group->fds[0], values, sizeof(values));
+    bool counted = len >= (ssize_t)((3 + group->len) * sizeof(uint64_t)) && values[2] > 0;
+    for (size_t i = 0; counted && i < group->len; ++i) {
+        counts[i] = values[2] < values[1]
+                        ? (uint64_t)((double)values[3 + i] * values[1] / values[2])
+                        : values[3 + i];
+    }
+    perf_close(group);
+    return counted;
+}
+#else
+typedef struct PerfGroup {
+    size_t len;
+} PerfGroup;
+
+static void
+perf_init() {
+    if (getenv("SOUFFLE_PERF")) {
+        fprintf(stderr, "SOUFFLE_PERF: performance counters are only supported on Linux\n");
+    }
+}
+
+static bool
+perf_open([[maybe_unused]] PerfGroup *group) {
+    return false;
+}
+
+static void
+perf_start([[maybe_unused]] PerfGroup *group) {
+}
+
+static bool
+perf_stop([[maybe_unused]] PerfGroup *group, [[maybe_unused]] uint64_t *counts) {
+    return false;
+}
+#endif // __linux__
+
+static long
+timeval_us(struct timeval tv) {
+    return (long)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static long
+maxrss_kb(const struct rusage *usage) {
+#ifdef __APPLE__
+    return usage->ru_maxrss / 1024;
+#else
+    return usage->ru_maxrss;
+#endif
+}
+
+// The resources used between two getrusage(2) (or since the start for wait4(2)). The peak RSS
+// is that of the whole process, which may have reached it before the test: callers sharing
+// their process with other tests keep it only if the test raised it.
+static ResourceUsage
+usage_between(const struct rusage *before, const struct rusage *after) {
+    return (ResourceUsage){
+        .max_rss_kb = maxrss_kb(after),
+        .user_us = timeval_us(after->ru_utime) - timeval_us(before->ru_utime),
+        .sys_us = timeval_us(after->ru_stime) - timeval_us(before->ru_stime),
+        .minor_faults = after->ru_minflt - before->ru_minflt,
+        .major_faults = after->ru_majflt - before->ru_majflt,
+        .voluntary_switches = after->ru_nvcsw - before->ru_nvcsw,
+        .involuntary_switches = after->ru_nivcsw - before->ru_nivcsw,
+    };
+}
+
+// Fail a test that went over the .max_rss_kb or .max_cpu_ms of its options. A peak RSS of 0 is
+// unknown and never fails.
+static void
+usage_check(StatusInfo *status_info, const TestOptions *options, const ResourceUsage *usage) {
+    if (status_info->status == Skip) {
+        return;
+    }
+    if (options->max_rss_kb > 0 && usage->max_rss_kb > options->max_rss_kb) {
+        souffle_log_msg_raw(status_info, "> Peak RSS of %ld kB over the limit of %ld kB\n",
+                            usage->max_rss_kb, options->max_rss_kb);
+        status_info->status = Fail;
+    }
+    long cpu_us = usage->user_us + usage->sys_us;
+    if (options->max_cpu_ms > 0 && cpu_us > options->max_cpu_ms * 1000) {
+        souffle_log_msg_raw(status_info, "> CPU time of %ld.%03ld ms over the limit of %ld ms\n",
+                            cpu_us / 1000, cpu_us % 1000, options->max_cpu_ms);
+        status_info->status = Fail;
+    }
+}
+
+// A worker's part of a result written by the test's own process: check the limits of its options
+// against what wait4(2) says the process used, adding what went over to the log.
+static void
+result_check_usage(size_t run, const TestOptions *options, const ResourceUsage *usage) {
+    SharedResult *result = &arena->results[run];
+    StatusInfo status_info = {.status = result->status, .msg = NULL};
+    if (result->log_len > 0) {
+        status_info.msg = string_init();
+        string_grow(status_info.msg, "%s", arena->logs + result->log_off);
+    }
+    usage_check(&status_info, options, usage);
+    if (status_info.msg && status_info.msg->len != result->log_len) {
+        result->status = status_info.status;
+        // the log being replaced is the runner's to give back: waiting for it would never end.
+        result_log(result, status_info.msg, false);
+    }
+    if (status_info.msg) {
+        string_free(status_info.msg);
+    }
+}
+
+// Run setup, test and teardown. `suite_ctx` is what the test's `*ctx` starts out as: the context
+// built by SUITE_SETUP, if any. `param` is the row of a TEST_P.
+static StatusInfo
+test_invoke(const Test *test, void *suite_ctx, const void *param) {
+    StatusInfo tstatus = {
+        .status = Success,
+        .msg = NULL,
+        .param = param,
+    };
+    void *ctx_internl = suite_ctx;
+    void **ctx = &ctx_internl;
+    if (test->setup) {
+        test->setup(ctx);
+    }
+    test->func(&tstatus, ctx);
+    if (test->teardown) {
+        test->teardown(ctx);
+    }
+    failures_conclude(&tstatus);
+    return tstatus;
+}
+
+// Run `runs[run]` in this process and write its result, with its SOUFFLE_PERF counts. The worker
+// waiting on a test's `own_process` publishes it, with what wait4(2) says it used. Otherwise the
+// test shares its process and is measured with getrusage(2): its peak RSS is only known if it
+// raised the process's.
+static enum Status
+test_execute(const TestRun *runs, size_t run, void *suite_ctx, bool own_process) {
+    const Test *test = runs[run].test;
+    PerfGroup group;
+    bool counting = perf_open(&group);
+    struct rusage before = {0};
+    if (!own_process) {
+        getrusage(RUSAGE_SELF, &before);
+    }
+    struct timespec start;
+    timespec_get(&start, TIME_UTC);
+    if (counting) {
+        perf_start(&group);
+    }
+    StatusInfo tstatus = test_invoke(test, suite_ctx, run_param(&runs[run]));
+    uint64_t counts[PERF_MAX_EVENTS];
+    counting = counting && perf_stop(&group, counts);
+    long elapsed_ms = elapsed_since(&start);
+    if (own_process) {
+        result_write(run, tstatus.status, elapsed_ms, tstatus.msg, counting ? counts : NULL);
+        atomic_store_explicit(&arena->results[run].state, ResultWritten, memory_order_release);
+    } else {
+        struct rusage after;
+        getrusage(RUSAGE_SELF, &after);
+        ResourceUsage usage = usage_between(&before, &after);
+        if (after.ru_maxrss <= before.ru_maxrss) {
+            usage.max_rss_kb = 0;
+        }
+        usage_check(&tstatus, &test->options, &usage);
+        result_write(run, tstatus.status, elapsed_ms, tstatus.msg, counting ? counts : NULL);
+        result_publish(run, &usage);
+    }
+    if (tstatus.msg) {
+        string_free(tstatus.msg);
+    }
+    return tstatus.status;
+}
+
+// The process running a single test. One made with vfork borrows its worker's memory, so it must
+// leave with _exit: exit would run the worker's atexit handlers and tear down its stdio.
+__attribute__((noreturn)) static void
+child_run_test(const TestRun *runs, size_t run, void *suite_ctx, bool vforked) {
+    // let the runner supervise the test. The worker already reset the signal dispositions.
+    result_start(run, getpid());
+    enum Status status = test_execute(runs, run, suite_ctx, true);
+    if (vforked) {
+        fflush(stdout);
+        _exit(status);
+    }
+    exit(status);
+}
+
+// The test's own timeout, else the one its history calls for, unless SOUFFLE_TIMEOUT is shorter.
+static long
+run_timeout_ms(const TestRun *run, const RunConfig *config) {
+    if (run->test->options.timeout_ms > 0) {
+        return run->test->options.timeout_ms;
+    }
+    if (run->history_timeout_ms > 0 && run->history_timeout_ms < config->timeout_ms) {
+        return run->history_timeout_ms;
+    }
+    return config->timeout_ms;
+}
+
+// Start supervising `run` running in `target`.
+static void
+slot_arm(Slot *slot, const TestRun *run, pid_t target, const RunConfig *config) {
+    slot->target = target;
+    slot->deadline = monotonic_ms() + run_timeout_ms(run, config);
+    slot->kills = 0;
+}
+
+// Escalate on a test that is past its deadline: SIGTERM first, SIGKILL after the grace period.
+static void
+slot_supervise(Slot *slot, int64_t now) {
+    if (slot->deadline == 0 || now < slot->deadline) {
+        return;
+    }
+    pid_t target = slot->target;
+    if (target == 0) {
+        // a worker's test: the child it forked for it, or the worker itself if it never got there
+        // (a zygote stuck in SUITE_SETUP).
+        pid_t child = result_pid(slot->run);
+        target = child ? child : slot->pid;
+    }
+    slot->timed_out = true;
+    if (slot->kills == 0) {
+        kill(target, SIGTERM);
+        slot->deadline = now + KILL_GRACE_MS;
+    } else {
+        kill(target, SIGKILL);
+        slot->deadline = 0;
+    }
+    slot->kills++;
+}
+
+// Done with the supervised test. A test the runner had to kill is a timeout, whatever its process
+// reported.
+static void
+slot_finish(Slot *slot, TestRun *run) {
+    if (slot->timed_out) {
+        failures += !status_failed(run->status);
+        run->status = Timeout;
+    }
+    slot->timed_out = false;
+    slot->deadline = 0;
+}
+
+static void
+slot_release(Slot *slot) {
+    if (slot->cmd >= 0) {
+        close(slot->cmd);
+    }
+    slot->cmd = -1;
+    slot->pid = 0;
+    slot->busy = false;
+}
+
+// Whether a worker lends the process of `run` its own memory (see worker_serve).
+static bool
+worker_vforks(bool fork_server, const Test *fixture, const TestRun *run) {
+    return !fork_server && !fixture && run->test->options.max_rss_kb <= 0;
+}
+
+// Worker loop: read a run index and run it in a process of its own, waiting for it.
+// A plain (isolated) worker lends that process its memory with vfork, which copies nothing. A test
+// that didn't exit cleanly may have left that memory in any state, so the worker then leaves too
+// and the runner starts a new one. So what a test leaves in memory is seen by the next tests of
+// the worker.
+// A `fork_server` worker forks instead: every test starts from a copy of the same warm image and
+// what it does to it goes away with it, so a test that crashes or times out only costs itself and
+// the worker carries on. A suite zygote builds the suite fixture first and forks, so every test
+// shares the fixture copy-on-write; it tears the fixture down once the runner closes `cmd`. So
+// does a test with a .max_rss_kb, whose peak RSS must be its own.
+__attribute__((noreturn)) static void
+worker_serve(TestRun *runs, int cmd, const Test *fixture, bool fork_server) {
+    child_signals();
+    void *suite_ctx = NULL;
+    if (fixture && fixture->suite_setup) {
+        fixture->suite_setup(&suite_ctx);
+    }
+    // the peak RSS of this process, which is also that of the children it vforks.
+    struct rusage self;
+    getrusage(RUSAGE_SELF, &self);
+    long peak_kb = maxrss_kb(&self);
+    size_t run;
+    while (read_full(cmd, &run, sizeof(run))) {
+        struct timespec start;
+        timespec_get(&start, TIME_UTC);
+        pid_t pid = worker_vforks(fork_server, fixture, &runs[run]) ? vfork() : fork();
+        if (pid == -1) {
+            perror("Failed to fork");
+            exit(EXIT_FAILURE);
+        }
+        if (pid == 0) {
+            close(cmd);
+            child_run_test(runs, run, suite_ctx, worker_vforks(fork_server, fixture, &runs[run]));
+        }
+        int status;
+        struct rusage rusage;
+        while (wait4(pid, &status, 0, &rusage) == -1 && errno == EINTR) {
+        }
+        bool vforked = worker_vforks(fork_server, fixture, &runs[run]);
+        ResourceUsage usage = usage_between(&(struct rusage){0}, &rusage);
+        if (vforked) {
+            if (usage.max_rss_kb > peak_kb) {
+                peak_kb = usage.max_rss_kb;
+            } else {
+                usage.max_rss_kb = 0;
+            }
+        }
+        bool leaving = vforked && !(WIFEXITED(status) && WEXITSTATUS(status) < Crashed);
+        if (atomic_load_explicit(&arena->results[run].state, memory_order_acquire) ==
+            ResultWritten) {
+            result_check_usage(run, &runs[run].test->options, &usage);
+        } else {
+            result_write(run, status_from_wait(status), elapsed_since(&start), NULL, NULL);
+        }
+        arena->results[run].retiring = leaving;
+        result_publish(run, &usage);
+        if (leaving) {
+            exit(EXIT_SUCCESS);
+        }
+    }
+    if (fixture && fixture->suite_teardown) {
+        fixture->suite_teardown(&suite_ctx);
+    }
+    exit(EXIT_SUCCESS);
+}
+
+// Called in a new long-lived child: drop the other workers' command pipes so they still see EOF
+// once the runner is done with them.
+static void
+close_other_slots(Slot *slots, int s, int jobs) {
+    for (int o = 0; o < jobs; ++o) {
+        if (o != s && slots[o].pid && slots[o].cmd >= 0) {
+            close(slots[o].cmd);
+        }
+    }
+}
+
+static void
+slot_spawn_worker(Slot *slots, int s, int jobs, TestRun *runs, const Test *fixture,
+                  bool fork_server) {
+    int cmdfd[2];
+    if (pipe(cmdfd) == -1) {
+        perror("Pipe failed");
+        exit(EXIT_FAILURE);
+    }
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == -1) {
+        perror("Failed to fork");
+        exit(EXIT_FAILURE);
+    }
+    if (pid == 0) {
+        close_other_slots(slots, s, jobs);
+        log_region = s;
+        close(cmdfd[1]);
+        worker_serve(runs, cmdfd[0], fixture, fork_server);
+    }
+    close(cmdfd[0]);
+    slots[s] = (Slot){
+        .pid = pid,
+        .cmd = cmdfd[1],
+        .server = true,
+    };
+}
+
+// Batch child: run [run, end) in this one process, each result being published as soon as it is
+// known. If a test crashes or gets killed, the runner charges it and resumes after it.
+__attribute__((noreturn)) static void
+batch_run(TestRun *runs, size_t run, size_t end) {
+    child_signals();
+    const Test *fixture = runs[run].test;
+    void *suite_ctx = NULL;
+    if (fixture->suite_setup) {
+        fixture->suite_setup(&suite_ctx);
+    }
+    for (; run < end; ++run) {
+        if (!runs[run].cached) {
+            test_execute(runs, run, suite_ctx, false);
+        }
+    }
+    if (fixture->suite_teardown) {
+        fixture->suite_teardown(&suite_ctx);
+    }
+    exit(EXIT_SUCCESS);
+}
+
+// (Re)start the batch child of a slot from `slot->next`.
+static void
+slot_spawn_batch(Slot *slots, int s, int jobs, TestRun *runs, const RunConfig *config) {
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == -1) {
+        perror("Failed to fork");
+        exit(EXIT_FAILURE);
+    }
+    if (pid == 0) {
+        close_other_slots(slots, s, jobs);
+        log_region = s;
+        batch_run(runs, slots[s].next, slots[s].end);
+    }
+    Slot *slot = &slots[s];
+    slot->pid = pid;
+    slot->cmd = -1;
+    slot->server = false;
+    slot->batch = true;
+    slot->busy = true;
+    timespec_get(&slot->start, TIME_UTC);
+    slot_arm(slot, &runs[slot->next], pid, config);
+}
+
+static void
+slot_dispatch(Slot *slot, TestRun *runs, size_t run, const RunConfig *config) {
+    // a worker that went away is reaped and charged for this run.
+    if (!write_full(slot->cmd, &run, sizeof(run))) {
+        perror("Failed to write to worker");
+    }
+    slot->run = run;
+    slot->busy = true;
+    timespec_get(&slot->start, TIME_UTC);
+    slot_arm(slot, &runs[run], 0, config);
+}
+
+// Move `next` past the runs that were cached.
+static void
+slot_skip_cached(Slot *slot, const TestRun *runs) {
+    while (slot->next < slot->end && runs[slot->next].cached) {
+        slot->next++;
+    }
+}
+
+// Closing the command pipe lets the worker finish its loop (and a zygote its suite teardown).
+static void
+slot_retire(Slot *slot) {
+    close(slot->cmd);
+    slot->cmd = -1;
+    slot->draining = true;
+}
+
+// Take whatever results the slot's processes published since last time.
+static void
+slot_progress(Slot *slot, TestRun *runs, const RunConfig *config) {
+    if (slot->batch) {
+        while (slot->next < slot->end && result_done(slot->next)) {
+            run_collect(runs, slot->next);
+            slot_finish(slot, &runs[slot->next]);
+            // the batch child moved on to the next test.
+            slot->next++;
+            slot_skip_cached(slot, runs);
+            timespec_get(&slot->start, TIME_UTC);
+            if (slot->next < slot->end) {
+                slot_arm(slot, &runs[slot->next], slot->pid, config);
+            }
+        }
+    } else if (slot->server && slot->busy && result_done(slot->run)) {
+        run_collect(runs, slot->run);
+        slot_finish(slot, &runs[slot->run]);
+        slot->busy = false;
+        if (arena->results[slot->run].retiring) {
+            slot_retire(slot);
+        }
+    }
+}
+
+// The slot's child exited. A worker that went away is charged for the test it was running, unless
+// it published it first; when a zygote dies its fixture is gone, so the rest of its suite is
+// charged as well. A batch child that went away early only costs the test it was running, the
+// slot resumes after it.
+static void
+slot_exited(Slot *slot, TestRun *runs) {
+    if (slot->batch) {
+        if (slot->next < slot->end) {
+            run_finish(&runs[slot->next], Crashed, elapsed_since(&slot->start));
+            slot_finish(slot, &runs[slot->next]);
+            slot->next++;
+        }
+    } else if (slot->busy) {
+        run_finish(&runs[slot->run], Crashed, elapsed_since(&slot->start));
+        slot_finish(slot, &runs[slot->run]);
+    }
+    if (slot->zygote) {
+        for (; slot->next < slot->end; ++slot->next) {
+            if (!runs[slot->next].cached) {
+                run_finish(&runs[slot->next], Crashed, 0);
+            }
+        }
+    }
+    slot_release(slot);
+    slot->zygote = false;
+    slot->draining = false;
+    slot->timed_out = false;
+    slot->deadline = 0;
+}
+
+static Slot *
+slot_of(Slot *slots, int jobs, pid_t pid) {
+    for (int s = 0; s < jobs; ++s) {
+        if (slots[s].pid == pid) {
+            return &slots[s];
+        }
+    }
+    return NULL;
+}
+
+static bool
+has_suite_fixture(const Test *test) {
+    return test->suite_setup || test->suite_teardown;
+}
+
+// With SOUFFLE_RERUN, what failed last time first. Then unknown units, then the longest; ties keep
+// registration order.
+static int
+unit_cmp(const void *a, const void *b) {
+    const RunUnit *ua = a;
+    const RunUnit *ub = b;
+    if (ua->failed_before != ub->failed_before) {
+        return ua->failed_before ? -1 : 1;
+    }
+    if (ua->known != ub->known) {
+        return ua->known ? 1 : -1;
+    }
+    if (ua->expected_ms != ub->expected_ms) {
+        return ua->expected_ms < ub->expected_ms ? 1 : -1;
+    }
+    return ua->first < ub->first ? -1 : ua->first > ub->first;
+}
+
+// Whether the unit starting at `run` holds rows of a TEST_P, run by a batch child.
+static bool
+is_row_chunk(const TestRun *run, const RunConfig *config) {
+    return config->mode != ModeBatch && run->test->nrows && !has_suite_fixture(run->test);
+}
+
+// Cut the runs into units, leaving out those whose tests are all cached. The rows of a TEST_P are
+// split in one chunk per job. With a history, the units known to take longest go first (and those
+// never seen before ahead of them) so the slowest tests don't end up running alone at the end.
+static size_t
+plan_units(RunUnit *units, const TestRun *runs, size_t nruns, const RunConfig *config) {
+    size_t nunits = 0;
+    for (size_t first = 0; first < nruns;) {
+        size_t end = first + 1;
+        if (config->mode == ModeBatch || has_suite_fixture(runs[first].test)) {
+            while (end < nruns && runs[end].suite == runs[first].suite) {
+                end++;
+            }
+        } else if (runs[first].test->nrows) {
+            size_t rows = first + 1;
+            while (rows < nruns && runs[rows].test == runs[first].test) {
+                rows++;
+            }
+            size_t chunk = (runs[first].test->nrows + config->jobs - 1) / config->jobs;
+            end = first + chunk < rows ? first + chunk : rows;
+        }
+        RunUnit unit = {.first = first, .end = end, .known = true};
+        bool cached = true;
+        for (size_t r = first; r < end; ++r) {
+            unit.failed_before = unit.failed_before || runs[r].failed_before;
+            unit.known = unit.known && runs[r].known;
+            unit.expected_ms += runs[r].expected_ms;
+            cached = cached && runs[r].cached;
+        }
+        if (!cached) {
+            units[nunits++] = unit;
+        }
+        first = end;
+    }
+    if (config->history) {
+        qsort(units, nunits, sizeof(RunUnit), unit_cmp);
+    }
+    return nunits;
+}
+
+// Give an idle slot its next piece of work and return the new `next_unit`. A unit holding a suite
+// or rows of a TEST_P goes to a batch child or, for a suite with SUITE_SETUP/SUITE_TEARDOWN, to a
+// zygote.
+static size_t
+slot_schedule(Slot *slots, int s, const RunConfig *config, TestRun *runs, const RunUnit *units,
+              size_t nunits, size_t next_unit) {
+    Slot *slot = &slots[s];
+    if (slot->busy || slot->draining) {
+        return next_unit;
+    }
+    if (slot->batch) {
+        slot_skip_cached(slot, runs);
+        if (slot->next < slot->end) {
+            slot_spawn_batch(slots, s, config->jobs, runs, config);
+            return next_unit;
+        }
+        slot->batch = false;
+    }
+    if (slot->zygote) {
+        slot_skip_cached(slot, runs);
+        if (slot->next < slot->end) {
+            slot_dispatch(slot, runs, slot->next++, config);
+        } else {
+            slot_retire(slot);
+        }
+        return next_unit;
+    }
+    if (next_unit >= nunits) {
+        return next_unit;
+    }
+    const RunUnit *unit = &units[next_unit];
+    if (is_row_chunk(&runs[unit->first], config) && slot->pid) {
+        // an idle worker holds the slot, make room for the batch child.
+        slot_retire(slot);
+        return next_unit;
+    }
+    if (config->mode == ModeBatch || is_row_chunk(&runs[unit->first], config)) {
+        slot->next = unit->first;
+        slot->end = unit->end;
+        slot_skip_cached(slot, runs);
+        slot_spawn_batch(slots, s, config->jobs, runs, config);
+        return next_unit + 1;
+    }
+    if (has_suite_fixture(runs[unit->first].test)) {
+        if (slot->pid) {
+            // an idle worker holds the slot, make room for the zygote.
+            slot_retire(slot);
+            return next_unit;
+        }
+        slot_spawn_worker(slots, s, config->jobs, runs, runs[unit->first].test, false);
+        slot->zygote = true;
+        slot->next = unit->first;
+        slot->end = unit->end;
+        slot_skip_cached(slot, runs);
+        slot_dispatch(slot, runs, slot->next++, config);
+        return next_unit + 1;
+    }
+    if (slot->pid == 0) {
+        slot_spawn_worker(slots, s, config->jobs, runs, NULL, config->mode == ModeServer);
+    }
+    slot_dispatch(slot, runs, unit->first, config);
+    return next_unit + 1;
+}
+
+// Milliseconds until the closest deadline, -1 if nothing is supervised.
+static int
+poll_timeout(const Slot *slots, int jobs, int64_t now) {
+    int64_t closest = -1;
+    for (int s = 0; s < jobs; ++s) {
+        if (slots[s].pid && slots[s].deadline) {
+            int64_t left = slots[s].deadline > now ? slots[s].deadline - now : 0;
+            if (closest == -1 || left < closest) {
+                closest = left;
+            }
+        }
+    }
+    return closest > INT32_MAX ? INT32_MAX : (int)closest;
+}
+
+// The process of slot `s` is gone, so nothing writes its log region: give back whatever it left
+// there unpublished.
+static void
+log_region_reset(int s) {
+    LogRegion *region = &arena->regions[s];
+    atomic_store_explicit(&region->freed,
+                          atomic_load_explicit(&region->written, memory_order_relaxed),
+                          memory_order_release);
+}
+
+// Reap every child that exited, after taking what it published before it went away.
+static void
+slots_reap(Slot *slots, TestRun *runs, const RunConfig *config) {
+    pid_t pid;
+    while ((pid = waitpid(-1, NULL, WNOHANG)) > 0) {
+        Slot *slot = slot_of(slots, config->jobs, pid);
+        if (slot) {
+            slot_progress(slot, runs, config);
+            slot_exited(slot, runs);
+            log_region_reset(slot - slots);
+        }
+    }
+}
+
+// SOUFFLE_FAIL_FAST gave up: kill everything still running, a worker's test as well as the
+// worker, keeping the results that made it. The tests cut short are left not done.
+static void
+slots_cancel(Slot *slots, TestRun *runs, const RunConfig *config) {
+    for (int s = 0; s < config->jobs; ++s) {
+        Slot *slot = &slots[s];
+        if (slot->pid == 0) {
+            continue;
+        }
+        slot_progress(slot, runs, config);
+        if (slot->server && slot->busy && result_pid(slot->run)) {
+            kill(result_pid(slot->run), SIGKILL);
+        }
+        pid_t pid = slot->pid;
+        kill(pid, SIGKILL);
+        waitpid(pid, NULL, 0);
+        slot_release(slot);
+        *slot = (Slot){.cmd = -1};
+    }
+}
+
+int
+run_all_tests() {
+    RunList list = select_runs();
+    TestRun *runs = list.runs;
+    size_t nruns = list.len;
+
+    RunConfig config = {
+        .jobs = jobs_count(nruns),
+        .mode = exec_mode(),
+        .timeout_ms = default_timeout_ms(),
+        .history = history_path(),
+        .rerun = rerun_mode(),
+        .build_id = build_id(),
+        .fail_fast = fail_fast_limit(),
+    };
+    perf_init();
+    if (config.rerun != RerunAll && config.history == NULL) {
+        fprintf(stderr, "SOUFFLE_RERUN needs SOUFFLE_HISTORY to know the last results\n");
+        config.rerun = RerunAll;
+    }
+    int jobs = config.jobs;
+    if (config.history) {
+        history_load(runs, nruns, &config);
+    }
+    RunUnit *units = calloc(nruns + 1, sizeof(RunUnit));
+    assert(units);
+    size_t nunits = plan_units(units, runs, nruns, &config);
+    // Setup Printing End Column
+    struct winsize w;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &w) == -1) {
+        w.ws_col = 80;
+    }
+    Console con;
+    console_register(&con, w.ws_col, &list);
+    report_files_register();
+    report_start(nruns);
+
+    // Results come back through shared memory, the doorbell only wakes the runner up.
+    arena_init(nruns, jobs);
+    if (pipe(doorbell) == -1) {
+        perror("Pipe failed");
+        exit(EXIT_FAILURE);
+    }
+    for (int end = 0; end < 2; ++end) {
+        fcntl(doorbell[end], F_SETFL, fcntl(doorbell[end], F_GETFL) | O_NONBLOCK);
+        fcntl(doorbell[end], F_SETFD, FD_CLOEXEC);
+    }
+    struct sigaction child_exit = {
+        .sa_handler = on_child_exit,
+        .sa_flags = SA_RESTART | SA_NOCLDSTOP,
+    };
+    struct sigaction prev_sigchld;
+    sigemptyset(&child_exit.sa_mask);
+    sigaction(SIGCHLD, &child_exit, &prev_sigchld);
+    // A worker that died must not take the runner down with it.
+    signal(SIGPIPE, SIG_IGN);
+    Slot *slots = calloc(jobs, sizeof(Slot));
+    assert(slots);
+    struct pollfd bell = {.fd = doorbell[0], .events = POLLIN};
+    size_t next_unit = 0;
+    size_t reported = 0;
+    RunSummary summary = {.tests = nruns};
+    bool cancelled = false;
+    while (true) {
+        // Print everything that finished, as long as it doesn't jump ahead of a running test. Once
+        // cancelled, nothing is running anymore and the runs that never finished are left out.
+        while (reported < nruns && (runs[reported].done || cancelled)) {
+            if (runs[reported].done) {
+                report_test(&runs[reported]);
+                free(runs[reported].msg);
+                runs[reported].msg = NULL;
+                summary.counts[runs[reported].status] += 1;
+                summary.cached += runs[reported].cached;
+            } else {
+                summary.not_run++;
+            }
+            reported++;
+        }
+        out_flush(&con.out);
+        if (reported == nruns) {
+            break;
+        }
+        if (config.fail_fast > 0 && failures >= (size_t)config.fail_fast) {
+            slots_cancel(slots, runs, &config);
+            cancelled = true;
+            continue;
+        }
+        for (int s = 0; s < jobs; ++s) {
+            next_unit = slot_schedule(slots, s, &config, runs, units, nunits, next_unit);
+        }
+        if (poll(&bell, 1, poll_timeout(slots, jobs, monotonic_ms())) == -1 && errno != EINTR) {
+            perror("Failed to poll");
+            exit(EXIT_FAILURE);
+        }
+        doorbell_drain();
+        slots_reap(slots, runs, &config);
+        int64_t now = monotonic_ms();
+        for (int s = 0; s < jobs; ++s) {
+            if (slots[s].pid) {
+                slot_progress(&slots[s], runs, &config);
+                slot_supervise(&slots[s], now);
+            }
+        }
+    }
+    for (int s = 0; s < jobs; ++s) {
+        if (slots[s].pid) {
+            // closing the command pipe tells the worker to exit.
+            pid_t pid = slots[s].pid;
+            slot_release(&slots[s]);
+            waitpid(pid, NULL, 0);
+        }
+    }
+    sigaction(SIGCHLD, &prev_sigchld, NULL);
+    close(doorbell[0]);
+    close(doorbell[1]);
+    free(slots);
+    if (config.history) {
+        history_save(runs, nruns, &config);
+    }
+    free(units);
+    runs_free(&list);
+    arena_free(nruns);
+
+    tests_free();
+    hashy_free(tag_index);
+    report_end(&summary);
+    if (failed_count(summary.counts) > 0) {
+        return 1;
+    }
+    return 0;
+}
+#else
+// Windows
+
+typedef struct ThreadInfo {
+    const Test *test;
+    StatusInfo *status_info;
+    void *suite_ctx;
+} ThreadInfo;
+
+DWORD WINAPI
+func_exec_timeout_win(LPVOID lpParam) {
+    ThreadInfo *ti = (ThreadInfo *)lpParam;
+    void *ctx_internl = ti->suite_ctx;
+    void **ctx = &ctx_internl;
+    TRY {
+        if (ti->test->setup) {
+            ti->test->setup(ctx);
+        }
+        if (ti->test->func) {
+            ti->test->func(ti->status_info, ctx);
+        }
+        if (ti->test->teardown) {
+            ti->test->teardown(ctx);
+        }
+        failures_conclude(ti->status_info);
+        return 0;
+    }
+    EXCEPT {
+        ti->status_info->status = Crashed;
+        return 0;
+    }
+}
+
+int
+run_all_tests_win() {
+    const char *var_name = "SOUFFLE_TIMEOUT";
+    size_t required_size;
+    DWORD timeout_time = 20000;
+    getenv_s(&required_size, NULL, 0, var_name);
+    if (required_size != 0) {
+        char env_value[required_size];
+        getenv_s(&required_size, env_value, required_size, var_name);
+        errno = 0;
+        char *endptr;
+        unsigned long ret = strtoul(env_value, &endptr, 10);
+        if (endptr != env_value && errno == 0) {
+            timeout_time = ret * 1000;
+        }
+    }
+    // Setup Printing End Column. Since we don't have ioctl in windows we need to use windows.h
+    CONSOLE_SCREEN_BUFFER_INFO csbi;
+    GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &csbi);
+
+    RunList list = select_runs();
+    Console con;
+    console_register(&con, csbi.srWindow.Right - csbi.srWindow.Left + 1, &list);
+    report_files_register();
+    report_start(list.len);
+
+    RunSummary summary = {.tests = list.len};
+    int *counts = summary.counts;
+    long fail_fast = fail_fast_limit();
+    void *suite_ctx = NULL;
+    for (size_t r = 0; r < list.len; ++r) {
+        TestRun *run = &list.runs[r];
+        const Test *test = run->test;
+        bool suite_first = r == 0 || list.runs[r - 1].suite != run->suite;
+        bool suite_last = r + 1 == list.len || list.runs[r + 1].suite != run->suite;
+        if (suite_first) {
+            // There is no fork here, every test of the suite shares the one fixture.
+            suite_ctx = NULL;
+            if (test->suite_setup) {
+                test->suite_setup(&suite_ctx);
+            }
+        }
+        struct timespec start, end;
+        timespec_get(&start, TIME_UTC);
+        StatusInfo tstatus = {
+            .status = Success,
+            .msg = NULL,
+            .param = run_param(run),
+        };
+
+        ThreadInfo tinfo = {
+            .test = test,
+            .status_info = &tstatus,
+            .suite_ctx = suite_ctx,
+        };
+        HANDLE thread = CreateThread(NULL, 0, func_exec_timeout_win, &tinfo, 0, NULL);
+        if (thread == NULL) {
+            perror("Failed to create thread");
+            exit(EXIT_FAILURE);
+        }
+        DWORD test_timeout =
+            test->options.timeout_ms > 0 ? (DWORD)test->options.timeout_ms : timeout_time;
+        DWORD wait_result = WaitForSingleObject(thread, test_timeout);
+        if (wait_result == WAIT_TIMEOUT) {
+            tstatus.status = Timeout;
+        } else if (wait_result == WAIT_FAILED) {
+            tstatus.status = Crashed;
+        }
+        timespec_get(&end, TIME_UTC);
+        run->status = tstatus.status;
+        run->elapsed_ms =
+            (end.tv_sec - start.tv_sec) * 1000 + (end.tv_nsec - start.tv_nsec) / 1000000;
+        run->msg = tstatus.msg ? tstatus.msg->buf : NULL;
+        run->done = true;
+        report_test(run);
+        out_flush(&con.out);
+        counts[run->status] += 1;
+        if (tstatus.msg) {
+            string_free(tstatus.msg);
+        }
+        CloseHandle(thread);
+        bool stop = fail_fast > 0 && failed_count(counts) >= fail_fast;
+        if ((suite_last || stop) && test->suite_teardown) {
+            test->suite_teardown(&suite_ctx);
+        }
+        if (stop) {
+            summary.not_run = list.len - r - 1;
+            break;
+        }
+    }
+    report_end(&summary);
+    runs_free(&list);
+
+    tests_free();
+    hashy_free(tag_index);
+    if (failed_count(counts) > 0) {
+        return 1;
+    }
+    return 0;
+}
+#endif
+
+__attribute__((weak)) int
+main(int argc, char **argv) {
+    const char *list = getenv("SOUFFLE_LIST");
+    bool list_only = list && strcmp(list, "1") == 0;
+    for (int i = 1; i < argc; ++i) {
+        list_only = list_only || strcmp(argv[i], "--list") == 0;
+    }
+    if (list_only) {
+        return list_tests();
+    }
+    if (bench_mode()) {
+        baseline_reset();
+    }
 #ifndef _WIN32
     int ret = run_all_tests();
 #else
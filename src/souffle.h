@@ -14,6 +14,8 @@ enum Status {
     Timeout,
     // Only for Windows since the tests run in a separate thread.
     Crashed,
+    // a benchmark significantly slower than in SOUFFLE_BENCH_BASELINE.
+    Regressed,
 };
 
 typedef struct SouffleString {
@@ -25,6 +27,10 @@ typedef struct SouffleString {
 typedef struct StatusInfo {
     enum Status status;
     SouffleString *msg;
+    // failed assertions and expectations so far.
+    size_t failures;
+    // the row of a TEST_P table being run, NULL for a plain TEST.
+    const void *param;
 } StatusInfo;
 
 // Utility macro: Make sure the function is only used the same way as printf
@@ -59,306 +65,615 @@ souffle_log_msg_raw(StatusInfo *status_info, const char *fmt, ...) PRINTF(2);
         return;                                                                                    \
     } while (0)
 
-#define ISFLOAT(x) _Generic((x), float: true, double: true, long double: true, default: false)
-#define ISUNSIGNED(x)                                                                              \
-    _Generic((x),                                                                                  \
-        unsigned char: true,                                                                       \
-        unsigned short: true,                                                                      \
-        unsigned int: true,                                                                        \
-        unsigned long: true,                                                                       \
-        unsigned long long: true,                                                                  \
-        default: false)
 // ---------------- ASSERTIONS ----------------
 
-#define ASSERT_TRUE(cond)                                                                          \
+// The assertions hand their operands, evaluated once, to the out-of-line checks below: each
+// returns false after marking the test failed and logging both sides, and the macro returns.
+typedef enum SouffleCmp {
+    SouffleEq,
+    SouffleNe,
+    SouffleLt,
+    SouffleLe,
+    SouffleGt,
+    SouffleGe,
+} SouffleCmp;
+
+bool
+souffle_cmp_int(StatusInfo *status_info, const char *file, int lineno, intmax_t a, intmax_t b,
+                SouffleCmp cmp);
+
+bool
+souffle_cmp_uint(StatusInfo *status_info, const char *file, int lineno, uintmax_t a, uintmax_t b,
+                 SouffleCmp cmp);
+
+bool
+souffle_cmp_double(StatusInfo *status_info, const char *file, int lineno, double a, double b,
+                   SouffleCmp cmp);
+
+bool
+souffle_cmp_long_double(StatusInfo *status_info, const char *file, int lineno, long double a,
+                        long double b, SouffleCmp cmp);
+
+bool
+souffle_cmp_ptr(StatusInfo *status_info, const char *file, int lineno, const void *a,
+                const void *b, SouffleCmp cmp);
+
+bool
+souffle_cmp_str(StatusInfo *status_info, const char *file, int lineno, const char *a,
+                const char *b, SouffleCmp cmp);
+
+// Compares the bytes of a[0, alen) and b[0, blen); only SouffleEq and SouffleNe.
+bool
+souffle_cmp_span(StatusInfo *status_info, const char *file, int lineno, const void *a,
+                 size_t alen, const void *b, size_t blen, SouffleCmp cmp);
+
+bool
+souffle_check_bool(StatusInfo *status_info, const char *file, int lineno, bool value,
+                   bool expected);
+
+bool
+souffle_check_null(StatusInfo *status_info, const char *file, int lineno, const void *ptr,
+                   bool expected_null);
+
+// The type both operands convert to for a comparison. Neither typeof nor _Generic evaluates it.
+#define SOUFFLE_CMP_TYPE(a, b) typeof(1 ? (a) : (b))
+
+// Picks the check for that type.
+#define SOUFFLE_CMP_FUNC(a, b)                                                                     \
+    _Generic((SOUFFLE_CMP_TYPE(a, b))0,                                                            \
+        float: souffle_cmp_double,                                                                 \
+        double: souffle_cmp_double,                                                                \
+        long double: souffle_cmp_long_double,                                                      \
+        unsigned int: souffle_cmp_uint,                                                            \
+        unsigned long: souffle_cmp_uint,                                                           \
+        unsigned long long: souffle_cmp_uint,                                                      \
+        default: souffle_cmp_int)
+
+// `on_fail` is `return` for the ASSERT_* macros and nothing for the EXPECT_* ones.
+#define SOUFFLE_CHECK(on_fail, check)                                                              \
     do {                                                                                           \
-        if (!cond) {                                                                               \
-            status_info->status = Fail;                                                            \
-            LOG_TRACE_MSG("Left:  \"true\"\n\t  >> Right: \"false\"\n");                           \
-            return;                                                                                \
+        if (!(check)) {                                                                            \
+            on_fail;                                                                               \
         }                                                                                          \
     } while (0)
 
-#define ASSERT_FALSE(cond)                                                                         \
+// Optimized builds compare inline and only call the check to report a failure, so the operands need
+// not outlive a call; unoptimized builds are smaller calling it outright.
+#ifdef __OPTIMIZE__
+#define SOUFFLE_CHECK_CMP(on_fail, a, b, cmp, op)                                                  \
     do {                                                                                           \
-        if (cond) {                                                                                \
-            status_info->status = Fail;                                                            \
-            LOG_TRACE_MSG("Left:  \"false\"\n\t  >> Right: \"true\"\n");                           \
-            return;                                                                                \
+        SOUFFLE_CMP_TYPE(a, b) souffle_a = (a), souffle_b = (b);                                   \
+        if (__builtin_expect(!(souffle_a op souffle_b), 0)) {                                      \
+            SOUFFLE_CMP_FUNC(a, b)(status_info, __FILE__, __LINE__, souffle_a, souffle_b, cmp);    \
+            on_fail;                                                                               \
         }                                                                                          \
     } while (0)
+#else
+#define SOUFFLE_CHECK_CMP(on_fail, a, b, cmp, op)                                                  \
+    SOUFFLE_CHECK(on_fail, SOUFFLE_CMP_FUNC(a, b)(status_info, __FILE__, __LINE__,                 \
+                                                  (SOUFFLE_CMP_TYPE(a, b))(a),                     \
+                                                  (SOUFFLE_CMP_TYPE(a, b))(b), cmp))
+#endif
 
-#define ASSERT_EQ(a, b)                                                                            \
-    do {                                                                                           \
-        if (a != b) {                                                                              \
-            status_info->status = Fail;                                                            \
-            if (ISFLOAT(a)) {                                                                      \
-                LOG_TRACE_MSG("Left:  \"%Lf\"\n\t  >> Right: \"%Lf\"\n", (long double)a,           \
-                              (long double)b);                                                     \
-            } else if (ISUNSIGNED(a)) {                                                            \
-                LOG_TRACE_MSG("Left:  \"%zu\"\n\t  >> Right: \"%zu\"\n", (uintmax_t)a,             \
-                              (uintmax_t)b);                                                       \
-            } else {                                                                               \
-                LOG_TRACE_MSG("Left:  \"%zd\"\n\t  >> Right: \"%zd\"\n", (intmax_t)a,              \
-                              (intmax_t)b);                                                        \
-            }                                                                                      \
-            return;                                                                                \
-        }                                                                                          \
-    } while (0)
+#define SOUFFLE_CHECK_TRUE(on_fail, cond)                                                          \
+    SOUFFLE_CHECK(on_fail, souffle_check_bool(status_info, __FILE__, __LINE__, (cond), true))
 
-#define ASSERT_PTR_EQ(a, b)                                                                        \
-    do {                                                                                           \
-        if (a != b) {                                                                              \
-            status_info->status = Fail;                                                            \
-            LOG_TRACE_MSG("Left:  \"%p\"\n\t  >> Right: \"%p\"\n", (void *)a, (void *)b);          \
-            return;                                                                                \
-        }                                                                                          \
-    } while (0)
+#define SOUFFLE_CHECK_FALSE(on_fail, cond)                                                         \
+    SOUFFLE_CHECK(on_fail, souffle_check_bool(status_info, __FILE__, __LINE__, (cond), false))
 
-#define ASSERT_PTR_NE(a, b)                                                                        \
-    do {                                                                                           \
-        if (a == b) {                                                                              \
-            status_info->status = Fail;                                                            \
-            LOG_TRACE_MSG("Left:  \"%p\"\n\t  >> Right: \"%p\"\n", (void *)a, (void *)b);          \
-            return;                                                                                \
-        }                                                                                          \
-    } while (0)
+#define SOUFFLE_CHECK_EQ(on_fail, a, b) SOUFFLE_CHECK_CMP(on_fail, a, b, SouffleEq, ==)
 
-#define ASSERT_NULL(a)                                                                             \
-    do {                                                                                           \
-        if (a != NULL) {                                                                           \
-            status_info->status = Fail;                                                            \
-            LOG_TRACE_MSG("Left:  \"NULL\"\n\t  >> Right: \"%p\"\n", (void *)a);                   \
-            return;                                                                                \
-        }                                                                                          \
-    } while (0)
+#define SOUFFLE_CHECK_NE(on_fail, a, b) SOUFFLE_CHECK_CMP(on_fail, a, b, SouffleNe, !=)
 
-#define ASSERT_NOT_NULL(a)                                                                         \
-    do {                                                                                           \
-        if (a == NULL) {                                                                           \
-            status_info->status = Fail;                                                            \
-            LOG_TRACE_MSG("Left:  \"NOT NULL\"\n\t  >> Right: \"NULL\"\n");                        \
-            return;                                                                                \
-        }                                                                                          \
-    } while (0)
+#define SOUFFLE_CHECK_LT(on_fail, a, b) SOUFFLE_CHECK_CMP(on_fail, a, b, SouffleLt, <)
 
-#define ASSERT_NE(a, b)                                                                            \
-    do {                                                                                           \
-        if (a == b) {                                                                              \
-            status_info->status = Fail;                                                            \
-            if (ISFLOAT(a)) {                                                                      \
-                LOG_TRACE_MSG("Left:  \"%Lf\"\n\t  >> Right: \"%Lf\"\n", (long double)a,           \
-                              (long double)b);                                                     \
-            } else if (ISUNSIGNED(a)) {                                                            \
-                LOG_TRACE_MSG("Left:  \"%zu\"\n\t  >> Right: \"%zu\"\n", (uintmax_t)a,             \
-                              (uintmax_t)b);                                                       \
-            } else {                                                                               \
-                LOG_TRACE_MSG("Left:  \"%zd\"\n\t  >> Right: \"%zd\"\n", (intmax_t)a,              \
-                              (intmax_t)b);                                                        \
-            }                                                                                      \
-            return;                                                                                \
-        }                                                                                          \
-    } while (0)
+#define SOUFFLE_CHECK_LTE(on_fail, a, b) SOUFFLE_CHECK_CMP(on_fail, a, b, SouffleLe, <=)
 
-#define ASSERT_LT(a, b)                                                                            \
-    do {                                                                                           \
-        if (a >= b) {                                                                              \
-            status_info->status = Fail;                                                            \
-            if (ISFLOAT(a)) {                                                                      \
-                LOG_TRACE_MSG("Left:  \"%Lf\"\n\t  >> Right: \"%Lf\"\n", (long double)a,           \
-                              (long double)b);                                                     \
-            } else if (ISUNSIGNED(a)) {                                                            \
-                LOG_TRACE_MSG("Left:  \"%zu\"\n\t  >> Right: \"%zu\"\n", (uintmax_t)a,             \
-                              (uintmax_t)b);                                                       \
-            } else {                                                                               \
-                LOG_TRACE_MSG("Left:  \"%zd\"\n\t  >> Right: \"%zd\"\n", (intmax_t)a,              \
-                              (intmax_t)b);                                                        \
-            }                                                                                      \
-            return;                                                                                \
-        }                                                                                          \
-    } while (0)
+#define SOUFFLE_CHECK_GT(on_fail, a, b) SOUFFLE_CHECK_CMP(on_fail, a, b, SouffleGt, >)
 
-#define ASSERT_LTE(a, b)                                                                           \
-    do {                                                                                           \
-        if (a > b) {                                                                               \
-            status_info->status = Fail;                                                            \
-            if (ISFLOAT(a)) {                                                                      \
-                LOG_TRACE_MSG("Left:  \"%Lf\"\n\t  >> Right: \"%Lf\"\n", (long double)a,           \
-                              (long double)b);                                                     \
-            } else if (ISUNSIGNED(a)) {                                                            \
-                LOG_TRACE_MSG("Left:  \"%zu\"\n\t  >> Right: \"%zu\"\n", (uintmax_t)a,             \
-                              (uintmax_t)b);                                                       \
-            } else {                                                                               \
-                LOG_TRACE_MSG("Left:  \"%zd\"\n\t  >> Right: \"%zd\"\n", (intmax_t)a,              \
-                              (intmax_t)b);                                                        \
-            }                                                                                      \
-            return;                                                                                \
-        }                                                                                          \
-    } while (0)
+#define SOUFFLE_CHECK_GTE(on_fail, a, b) SOUFFLE_CHECK_CMP(on_fail, a, b, SouffleGe, >=)
 
-#define ASSERT_GT(a, b)                                                                            \
-    do {                                                                                           \
-        if (a <= b) {                                                                              \
-            status_info->status = Fail;                                                            \
-            if (ISFLOAT(a)) {                                                                      \
-                LOG_TRACE_MSG("Left:  \"%Lf\"\n\t  >> Right: \"%Lf\"\n", (long double)a,           \
-                              (long double)b);                                                     \
-            } else if (ISUNSIGNED(a)) {                                                            \
-                LOG_TRACE_MSG("Left:  \"%zu\"\n\t  >> Right: \"%zu\"\n", (uintmax_t)a,             \
-                              (uintmax_t)b);                                                       \
-            } else {                                                                               \
-                LOG_TRACE_MSG("Left:  \"%zd\"\n\t  >> Right: \"%zd\"\n", (intmax_t)a,              \
-                              (intmax_t)b);                                                        \
-            }                                                                                      \
-            return;                                                                                \
-        }                                                                                          \
-    } while (0)
+#define SOUFFLE_CHECK_PTR_EQ(on_fail, a, b)                                                        \
+    SOUFFLE_CHECK(on_fail, souffle_cmp_ptr(status_info, __FILE__, __LINE__, (const void *)(a),     \
+                                           (const void *)(b), SouffleEq))
 
-#define ASSERT_GTE(a, b)                                                                           \
-    do {                                                                                           \
-        if (a < b) {                                                                               \
-            status_info->status = Fail;                                                            \
-            if (ISFLOAT(a)) {                                                                      \
-                LOG_TRACE_MSG("Left:  \"%Lf\"\n\t  >> Right: \"%Lf\"\n", (long double)a,           \
-                              (long double)b);                                                     \
-            } else if (ISUNSIGNED(a)) {                                                            \
-                LOG_TRACE_MSG("Left:  \"%zu\"\n\t  >> Right: \"%zu\"\n", (uintmax_t)a,             \
-                              (uintmax_t)b);                                                       \
-            } else {                                                                               \
-                LOG_TRACE_MSG("Left:  \"%zd\"\n\t  >> Right: \"%zd\"\n", (intmax_t)a,              \
-                              (intmax_t)b);                                                        \
-            }                                                                                      \
-            return;                                                                                \
-        }                                                                                          \
-    } while (0)
+#define SOUFFLE_CHECK_PTR_NE(on_fail, a, b)                                                        \
+    SOUFFLE_CHECK(on_fail, souffle_cmp_ptr(status_info, __FILE__, __LINE__, (const void *)(a),     \
+                                           (const void *)(b), SouffleNe))
 
-#define ASSERT_STR_EQ(str1, str2)                                                                  \
-    do {                                                                                           \
-        if (strcmp(str1, str2) != 0) {                                                             \
-            status_info->status = Fail;                                                            \
-            LOG_TRACE_MSG("Left:  \"%s\"\n\t  >> Right: \"%s\"\n", str1, str2);                    \
-            return;                                                                                \
-        }                                                                                          \
-    } while (0)
+#define SOUFFLE_CHECK_NULL(on_fail, a)                                                             \
+    SOUFFLE_CHECK(on_fail, souffle_check_null(status_info, __FILE__, __LINE__,                     \
+                                              (const void *)(a), true))
 
-#define ASSERT_STR_NE(str1, str2)                                                                  \
-    do {                                                                                           \
-        if (strcmp(str1, str2) == 0) {                                                             \
-            status_info->status = Fail;                                                            \
-            LOG_TRACE_MSG("Left:  \"%s\"\n\t  >> Right: \"%s\"\n", str1, str2);                    \
-            return;                                                                                \
-        }                                                                                          \
-    } while (0)
+#define SOUFFLE_CHECK_NOT_NULL(on_fail, a)                                                         \
+    SOUFFLE_CHECK(on_fail, souffle_check_null(status_info, __FILE__, __LINE__,                     \
+                                              (const void *)(a), false))
+
+#define SOUFFLE_CHECK_STR_EQ(on_fail, str1, str2)                                                  \
+    SOUFFLE_CHECK(on_fail,                                                                         \
+                  souffle_cmp_str(status_info, __FILE__, __LINE__, str1, str2, SouffleEq))
 
-#define ASSERT_INT_ARR_EQ(arr1, arr2, size)                                                        \
+#define SOUFFLE_CHECK_STR_NE(on_fail, str1, str2)                                                  \
+    SOUFFLE_CHECK(on_fail,                                                                         \
+                  souffle_cmp_str(status_info, __FILE__, __LINE__, str1, str2, SouffleNe))
+
+#define SOUFFLE_CHECK_SPAN_EQ(on_fail, ptr1, len1, ptr2, len2)                                     \
+    SOUFFLE_CHECK(on_fail, souffle_cmp_span(status_info, __FILE__, __LINE__, (ptr1), (len1),       \
+                                            (ptr2), (len2), SouffleEq))
+
+#define SOUFFLE_CHECK_SPAN_NE(on_fail, ptr1, len1, ptr2, len2)                                     \
+    SOUFFLE_CHECK(on_fail, souffle_cmp_span(status_info, __FILE__, __LINE__, (ptr1), (len1),       \
+                                            (ptr2), (len2), SouffleNe))
+
+// The array checks compare whole blocks (memcmp, or a loop the compiler vectorizes for floats). A
+// failure reports how many elements differ and a window of both arrays around the first one.
+typedef enum SouffleElem {
+    SouffleElemInt,
+    SouffleElemUint,
+    SouffleElemFloat,
+    SouffleElemByte,
+} SouffleElem;
+
+bool
+souffle_cmp_arr(StatusInfo *status_info, const char *file, int lineno, const void *a,
+                const void *b, size_t len, size_t elem_size, SouffleElem elem);
+
+// Floating point elements match when they are within `epsilon` of each other or at most `ulps`
+// representable values apart.
+bool
+souffle_cmp_arr_near(StatusInfo *status_info, const char *file, int lineno, const void *a,
+                     const void *b, size_t len, size_t elem_size, double epsilon, uint64_t ulps);
+
+#define SOUFFLE_IS_FLOAT(x) _Generic((x), float: 1, double: 1, long double: 1, default: 0)
+
+#define SOUFFLE_CHECK_ARR(on_fail, arr1, arr2, size, elem)                                         \
     do {                                                                                           \
-        for (typeof(size) i = 0; i < size; ++i) {                                                  \
-            if (((arr1)[i] != (arr2)[i])) {                                                        \
-                status_info->status = Fail;                                                        \
-                break;                                                                             \
-            }                                                                                      \
-        }                                                                                          \
-        if (status_info->status == Fail) {                                                         \
-            LOG_TRACE_MSG("Left:  [ %zd", (intmax_t)arr1[0]);                                      \
-            for (typeof(size) i = 1; i < size; ++i) {                                              \
-                LOG_MSG(", %zd", (intmax_t)arr1[i]);                                               \
-            }                                                                                      \
-            LOG_MSG(" ]");                                                                         \
-            LOG_MSG("\n\t  >> Right: [ %zd", (intmax_t)arr2[0]);                                   \
-            for (typeof(size) i = 1; i < size; ++i) {                                              \
-                LOG_MSG(", %zd", (intmax_t)arr2[i]);                                               \
-            }                                                                                      \
-            LOG_MSG(" ]\n");                                                                       \
-            return;                                                                                \
-        }                                                                                          \
+        _Static_assert(sizeof(*(arr1)) == sizeof(*(arr2)), "array elements differ in size");       \
+        SOUFFLE_CHECK(on_fail, souffle_cmp_arr(status_info, __FILE__, __LINE__, (arr1), (arr2),    \
+                                               (size), sizeof(*(arr1)), elem));                    \
     } while (0)
 
-#define ASSERT_UINT_ARR_EQ(arr1, arr2, size)                                                       \
+#define SOUFFLE_CHECK_INT_ARR_EQ(on_fail, arr1, arr2, size)                                        \
+    SOUFFLE_CHECK_ARR(on_fail, arr1, arr2, size, SouffleElemInt)
+
+#define SOUFFLE_CHECK_UINT_ARR_EQ(on_fail, arr1, arr2, size)                                       \
+    SOUFFLE_CHECK_ARR(on_fail, arr1, arr2, size, SouffleElemUint)
+
+#define SOUFFLE_CHECK_FLOAT_ARR_EQ(on_fail, arr1, arr2, size)                                      \
     do {                                                                                           \
-        for (typeof(size) i = 0; i < size; ++i) {                                                  \
-            if (((arr1)[i] != (arr2)[i])) {                                                        \
-                status_info->status = Fail;                                                        \
-                break;                                                                             \
-            }                                                                                      \
-        }                                                                                          \
-        if (status_info->status == Fail) {                                                         \
-            LOG_TRACE_MSG("Left:  [ %d", (uintmax_t)arr1[0]);                                      \
-            for (typeof(size) i = 1; i < size; ++i) {                                              \
-                LOG_MSG(", %zu", (uintmax_t)arr1[i]);                                              \
-            }                                                                                      \
-            LOG_MSG(" ]");                                                                         \
-            LOG_MSG("\n\t  >> Right: [ %zu", (uintmax_t)arr2[0]);                                  \
-            for (typeof(size) i = 1; i < size; ++i) {                                              \
-                LOG_MSG(", %zu", (uintmax_t)arr2[i]);                                              \
-            }                                                                                      \
-            LOG_MSG(" ]\n");                                                                       \
-            return;                                                                                \
-        }                                                                                          \
+        _Static_assert(SOUFFLE_IS_FLOAT(*(arr1)), "not a floating point array");                   \
+        SOUFFLE_CHECK_ARR(on_fail, arr1, arr2, size, SouffleElemFloat);                            \
     } while (0)
 
-#define ASSERT_FLOAT_ARR_EQ(arr1, arr2, size)                                                      \
+#define SOUFFLE_CHECK_FLOAT_ARR_NEAR(on_fail, arr1, arr2, size, epsilon, ulps)                     \
     do {                                                                                           \
-        for (typeof(size) i = 0; i < size; ++i) {                                                  \
-            if (((arr1)[i] != (arr2)[i])) {                                                        \
-                status_info->status = Fail;                                                        \
-                break;                                                                             \
-            }                                                                                      \
-        }                                                                                          \
-        if (status_info->status == Fail) {                                                         \
-            LOG_TRACE_MSG("Left:  [ %Lf", (long double)arr1[0]);                                   \
-            for (typeof(size) i = 1; i < size; ++i) {                                              \
-                LOG_MSG(", %Lf", (long double)arr1[i]);                                            \
-            }                                                                                      \
-            LOG_MSG(" ]");                                                                         \
-            LOG_MSG("\n\t  >> Right: [ %Lf", (long double)arr2[0]);                                \
-            for (typeof(size) i = 1; i < size; ++i) {                                              \
-                LOG_MSG(", %Lf", (long double)arr2[i]);                                            \
-            }                                                                                      \
-            LOG_MSG(" ]\n");                                                                       \
-            return;                                                                                \
-        }                                                                                          \
+        _Static_assert(SOUFFLE_IS_FLOAT(*(arr1)), "not a floating point array");                   \
+        _Static_assert(sizeof(*(arr1)) == sizeof(*(arr2)), "array elements differ in size");       \
+        SOUFFLE_CHECK(on_fail, souffle_cmp_arr_near(status_info, __FILE__, __LINE__, (arr1),       \
+                                                    (arr2), (size), sizeof(*(arr1)), (epsilon),    \
+                                                    (ulps)));                                      \
     } while (0)
 
+#define SOUFFLE_CHECK_MEM_EQ(on_fail, ptr1, ptr2, size)                                            \
+    SOUFFLE_CHECK(on_fail, souffle_cmp_arr(status_info, __FILE__, __LINE__, (ptr1), (ptr2),        \
+                                           (size), 1, SouffleElemByte))
+
+// The ASSERT_* macros stop the test at the first failure.
+#define ASSERT_TRUE(cond) SOUFFLE_CHECK_TRUE(return, cond)
+
+#define ASSERT_FALSE(cond) SOUFFLE_CHECK_FALSE(return, cond)
+
+#define ASSERT_EQ(a, b) SOUFFLE_CHECK_EQ(return, a, b)
+
+#define ASSERT_NE(a, b) SOUFFLE_CHECK_NE(return, a, b)
+
+#define ASSERT_LT(a, b) SOUFFLE_CHECK_LT(return, a, b)
+
+#define ASSERT_LTE(a, b) SOUFFLE_CHECK_LTE(return, a, b)
+
+#define ASSERT_GT(a, b) SOUFFLE_CHECK_GT(return, a, b)
+
+#define ASSERT_GTE(a, b) SOUFFLE_CHECK_GTE(return, a, b)
+
+#define ASSERT_PTR_EQ(a, b) SOUFFLE_CHECK_PTR_EQ(return, a, b)
+
+#define ASSERT_PTR_NE(a, b) SOUFFLE_CHECK_PTR_NE(return, a, b)
+
+#define ASSERT_NULL(a) SOUFFLE_CHECK_NULL(return, a)
+
+#define ASSERT_NOT_NULL(a) SOUFFLE_CHECK_NOT_NULL(return, a)
+
+#define ASSERT_STR_EQ(str1, str2) SOUFFLE_CHECK_STR_EQ(return, str1, str2)
+
+#define ASSERT_STR_NE(str1, str2) SOUFFLE_CHECK_STR_NE(return, str1, str2)
+
+#define ASSERT_SPAN_EQ(ptr1, len1, ptr2, len2) SOUFFLE_CHECK_SPAN_EQ(return, ptr1, len1, ptr2, len2)
+
+#define ASSERT_SPAN_NE(ptr1, len1, ptr2, len2) SOUFFLE_CHECK_SPAN_NE(return, ptr1, len1, ptr2, len2)
+
+#define ASSERT_INT_ARR_EQ(arr1, arr2, size) SOUFFLE_CHECK_INT_ARR_EQ(return, arr1, arr2, size)
+
+#define ASSERT_UINT_ARR_EQ(arr1, arr2, size) SOUFFLE_CHECK_UINT_ARR_EQ(return, arr1, arr2, size)
+
+#define ASSERT_FLOAT_ARR_EQ(arr1, arr2, size) SOUFFLE_CHECK_FLOAT_ARR_EQ(return, arr1, arr2, size)
+
+#define ASSERT_FLOAT_ARR_NEAR(arr1, arr2, size, epsilon, ulps)                                     \
+    SOUFFLE_CHECK_FLOAT_ARR_NEAR(return, arr1, arr2, size, epsilon, ulps)
+
+#define ASSERT_MEM_EQ(ptr1, ptr2, size) SOUFFLE_CHECK_MEM_EQ(return, ptr1, ptr2, size)
+
+// The EXPECT_* macros mark the test failed, log the failure and let it go on.
+#define EXPECT_TRUE(cond) SOUFFLE_CHECK_TRUE((void)0, cond)
+
+#define EXPECT_FALSE(cond) SOUFFLE_CHECK_FALSE((void)0, cond)
+
+#define EXPECT_EQ(a, b) SOUFFLE_CHECK_EQ((void)0, a, b)
+
+#define EXPECT_NE(a, b) SOUFFLE_CHECK_NE((void)0, a, b)
+
+#define EXPECT_LT(a, b) SOUFFLE_CHECK_LT((void)0, a, b)
+
+#define EXPECT_LTE(a, b) SOUFFLE_CHECK_LTE((void)0, a, b)
+
+#define EXPECT_GT(a, b) SOUFFLE_CHECK_GT((void)0, a, b)
+
+#define EXPECT_GTE(a, b) SOUFFLE_CHECK_GTE((void)0, a, b)
+
+#define EXPECT_PTR_EQ(a, b) SOUFFLE_CHECK_PTR_EQ((void)0, a, b)
+
+#define EXPECT_PTR_NE(a, b) SOUFFLE_CHECK_PTR_NE((void)0, a, b)
+
+#define EXPECT_NULL(a) SOUFFLE_CHECK_NULL((void)0, a)
+
+#define EXPECT_NOT_NULL(a) SOUFFLE_CHECK_NOT_NULL((void)0, a)
+
+#define EXPECT_STR_EQ(str1, str2) SOUFFLE_CHECK_STR_EQ((void)0, str1, str2)
+
+#define EXPECT_STR_NE(str1, str2) SOUFFLE_CHECK_STR_NE((void)0, str1, str2)
+
+#define EXPECT_SPAN_EQ(ptr1, len1, ptr2, len2)                                                     \
+    SOUFFLE_CHECK_SPAN_EQ((void)0, ptr1, len1, ptr2, len2)
+
+#define EXPECT_SPAN_NE(ptr1, len1, ptr2, len2)                                                     \
+    SOUFFLE_CHECK_SPAN_NE((void)0, ptr1, len1, ptr2, len2)
+
+#define EXPECT_INT_ARR_EQ(arr1, arr2, size) SOUFFLE_CHECK_INT_ARR_EQ((void)0, arr1, arr2, size)
+
+#define EXPECT_UINT_ARR_EQ(arr1, arr2, size) SOUFFLE_CHECK_UINT_ARR_EQ((void)0, arr1, arr2, size)
+
+#define EXPECT_FLOAT_ARR_EQ(arr1, arr2, size) SOUFFLE_CHECK_FLOAT_ARR_EQ((void)0, arr1, arr2, size)
+
+#define EXPECT_FLOAT_ARR_NEAR(arr1, arr2, size, epsilon, ulps)                                     \
+    SOUFFLE_CHECK_FLOAT_ARR_NEAR((void)0, arr1, arr2, size, epsilon, ulps)
+
+#define EXPECT_MEM_EQ(ptr1, ptr2, size) SOUFFLE_CHECK_MEM_EQ((void)0, ptr1, ptr2, size)
+
 // -------------- ASSERTIONS END --------------
 
+// ---------------- PROPERTIES ----------------
+
+// Where the body of a PROPERTY draws its inputs from. Every draw is recorded, so a failing input
+// can be replayed and shrunk.
+typedef struct SouffleGen SouffleGen;
+
+typedef void (*PropertyFunc)(StatusInfo *status_info, void **ctx, SouffleGen *gen);
+
+// Runs `prop` against SOUFFLE_PROPERTY_RUNS generated inputs and logs the smallest failing one.
+void
+souffle_property(StatusInfo *status_info, void **ctx, PropertyFunc prop, const char *name);
+
+// A value in [min, max], shrinking towards 0 (or the bound closest to it).
+int64_t
+souffle_gen_int(SouffleGen *gen, int64_t min, int64_t max);
+
+uint64_t
+souffle_gen_uint(SouffleGen *gen, uint64_t min, uint64_t max);
+
+// A finite value in [min, max], shrinking towards 0 (or the bound closest to it).
+double
+souffle_gen_double(SouffleGen *gen, double min, double max);
+
+// Between min_len and max_len bytes, shrinking towards fewer and smaller bytes. The buffer is valid
+// until the body returns.
+const unsigned char *
+souffle_gen_bytes(SouffleGen *gen, size_t *len, size_t min_len, size_t max_len);
+
+// A string of between min_len and max_len printable ASCII characters, shrinking towards shorter
+// strings of 'a'. The string is valid until the body returns.
+const char *
+souffle_gen_str(SouffleGen *gen, size_t min_len, size_t max_len);
+
+#define GEN_INT(min, max) souffle_gen_int(gen, min, max)
+
+#define GEN_UINT(min, max) souffle_gen_uint(gen, min, max)
+
+#define GEN_DOUBLE(min, max) souffle_gen_double(gen, min, max)
+
+#define GEN_BYTES(len_ptr, min_len, max_len) souffle_gen_bytes(gen, len_ptr, min_len, max_len)
+
+#define GEN_STR(min_len, max_len) souffle_gen_str(gen, min_len, max_len)
+
+// -------------- PROPERTIES END --------------
+
+// ---------------- BENCHMARKS ----------------
+
+// The state of the timing loop of a BENCH.
+typedef struct SouffleBench SouffleBench;
+
+typedef void (*BenchFunc)(StatusInfo *status_info, void **ctx, SouffleBench *bench);
+
+// The arguments a BENCH runs with, see TestOptions.
+typedef struct BenchRange {
+    uint64_t min;
+    uint64_t max;
+} BenchRange;
+
+// Runs `func`, whose BENCH_LOOP does the timing, and logs the statistics of the samples. With a
+// `range`, once per argument, and the complexity the times fit.
+void
+souffle_bench(StatusInfo *status_info, void **ctx, BenchFunc func, const char *name,
+              BenchRange range);
+
+uint64_t
+souffle_bench_arg(const SouffleBench *bench);
+
+// Ends a round of the timing loop and starts the next, with `*left` set to its iterations after
+// the one about to run. False once the last round is done.
+bool
+souffle_bench_next(SouffleBench *bench, uint64_t *left);
+
+// Runs the statement after it for timed rounds of many iterations: first to calibrate how many
+// make a round, then to warm up, then to take the samples. Only the end of a round calls out.
+#define BENCH_LOOP                                                                                 \
+    for (uint64_t souffle_left = 0;                                                                \
+         souffle_left-- > 0 || souffle_bench_next(bench, &souffle_left);)
+
+// The argument the benchmark runs with, 0 without a .range.
+#define BENCH_ARG souffle_bench_arg(bench)
+
+// Makes the compiler assume `value` is used, so that the code computing it is kept.
+#define DO_NOT_OPTIMIZE(value) __asm__ volatile("" : : "r,m"(value) : "memory")
+
+// Makes the compiler assume all memory is read and written, so that stores are kept.
+#define CLOBBER_MEMORY() __asm__ volatile("" : : : "memory")
+
+// -------------- BENCHMARKS END --------------
+
 typedef void (*TestFunc)(StatusInfo *status_info, void **ctx);
 
 typedef void (*SetupFunc)(void **ctx);
 
 typedef void (*TeardownFunc)(void **ctx);
 
+// Optional per-test settings, given as designated initializers after the test name:
+// TEST(suite, name, .timeout_ms = 200, .tags = "slow,net")
+typedef struct TestOptions {
+    // overrides SOUFFLE_TIMEOUT for this test.
+    long timeout_ms;
+    // comma or space separated, selected with "@tag" in SOUFFLE_FILTER.
+    const char *tags;
+    // BENCH: run with BENCH_ARG at range.min, doubling up to range.max.
+    BenchRange range;
+    // fail the test when it peaks above this many kilobytes of RSS. Enforced where the peak is
+    // the test's own: its own forked process (isolated and server modes, SUITE_SETUP suites), or
+    // a shared process (batch, TEST_P rows) whose peak the test raised. A test that stays under
+    // the peak of an earlier test in its process never fails for it.
+    long max_rss_kb;
+    // fail the test when its setup, test and teardown take more user and system CPU time.
+    long max_cpu_ms;
+} TestOptions;
+
 typedef struct Test {
+    const char *suite;
     const char *name;
     TestFunc func;
     SetupFunc setup;
     TeardownFunc teardown;
+    SetupFunc suite_setup;
+    TeardownFunc suite_teardown;
+    TestOptions options;
+    // TEST_P: the parameter table, `nrows` rows of `row_size` bytes, each run as its own test.
+    const void *rows;
+    size_t nrows;
+    size_t row_size;
+    // BENCH: only run with SOUFFLE_BENCH=1, which runs nothing else.
+    bool bench;
+    // where the test is defined, which orders the tests of a suite.
+    const char *file;
+    int line;
+    // one bit per tag, assigned when the runner collects the tests.
+    uint64_t tag_mask;
 } Test;
 
-typedef struct TestsVec {
-    Test *tests;
-    size_t capacity;
-    size_t len;
-} TestsVec;
+// Add the tests [first, end): a module's souffle_tests section, or a single test.
+void
+register_tests(Test *first, Test *end);
 
 void
 register_test(const char *suite, const char *name, TestFunc func, SetupFunc setup,
-              TeardownFunc teardown);
+              TeardownFunc teardown, SetupFunc suite_setup, TeardownFunc suite_teardown,
+              TestOptions options);
 
 int
 run_all_tests();
 
+// A performance counter of a test, from SOUFFLE_PERF.
+typedef struct PerfCount {
+    const char *event;
+    uint64_t value;
+} PerfCount;
+
+// Resources used by a test, from wait4(2) or getrusage(2). Times are in microseconds.
+typedef struct ResourceUsage {
+    // peak resident set size of the test, in kilobytes. 0 when unknown: the test shared its
+    // process with earlier tests and stayed under the peak they reached.
+    long max_rss_kb;
+    long user_us;
+    long sys_us;
+    long minor_faults;
+    long major_faults;
+    long voluntary_switches;
+    long involuntary_switches;
+} ResourceUsage;
+
+// What a reporter is told about each test.
+typedef struct TestResult {
+    const char *suite;
+    const Test *test;
+    // the test's name, "name/row_<i>" for a row of a TEST_P.
+    const char *name;
+    enum Status status;
+    long elapsed_ms;
+    // what the test logged, NULL if nothing.
+    const char *msg;
+    // the log was cut short.
+    bool truncated;
+    // passed last time in the same binary, not run again (SOUFFLE_RERUN=only-failed).
+    bool cached;
+    // the SOUFFLE_PERF counters, `nperf` of them. NULL when the test has none.
+    const PerfCount *perf;
+    size_t nperf;
+    // what the test used, NULL when it didn't run (cached) or wasn't measured (Windows).
+    const ResourceUsage *usage;
+} TestResult;
+
+typedef struct RunSummary {
+    size_t tests;
+    // tests per enum Status.
+    int counts[Regressed + 1];
+    size_t cached;
+    // left out by SOUFFLE_FAIL_FAST.
+    size_t not_run;
+} RunSummary;
+
+// Receives a run as it goes: the tests are reported in registration order, each suite announced
+// before its first test. Any callback can be NULL; `data` is handed back to every one of them.
+typedef struct TestReporter {
+    void (*on_run_start)(void *data, size_t ntests);
+    void (*on_suite_start)(void *data, const char *suite);
+    void (*on_test_end)(void *data, const TestResult *result);
+    void (*on_run_end)(void *data, const RunSummary *summary);
+    void *data;
+} TestReporter;
+
+// Add a reporter next to the console output, e.g. from an __attribute__((constructor)) function.
+void
+register_reporter(TestReporter reporter);
+
 #define SETUP(suite, name) __attribute__((weak)) void suite##_##name##_setup(void **ctx)
 
 #define TEARDOWN(suite, name) __attribute__((weak)) void suite##_##name##_teardown(void **ctx)
 
-#define TEST(suite, name)                                                                          \
+// Built once per suite in a zygote process that every test of the suite is forked from.
+#define SUITE_SETUP(suite) __attribute__((weak)) void suite##__suite_setup(void **ctx)
+
+#define SUITE_TEARDOWN(suite) __attribute__((weak)) void suite##__suite_teardown(void **ctx)
+
+#define SOUFFLE_TEST_DESC(test_suite, test_name, is_bench, table, table_rows, table_row_size, ...) \
+    {                                                                                              \
+        .suite = #test_suite,                                                                      \
+        .name = #test_name,                                                                        \
+        .func = test_suite##_##test_name,                                                          \
+        .setup = test_suite##_##test_name##_setup,                                                 \
+        .teardown = test_suite##_##test_name##_teardown,                                           \
+        .suite_setup = test_suite##__suite_setup,                                                  \
+        .suite_teardown = test_suite##__suite_teardown,                                            \
+        .options = {__VA_ARGS__},                                                                  \
+        .rows = table,                                                                             \
+        .nrows = table_rows,                                                                       \
+        .row_size = table_row_size,                                                                \
+        .bench = is_bench,                                                                         \
+        .file = __FILE__,                                                                          \
+        .line = __LINE__,                                                                          \
+    }
+
+// On ELF targets a test is only a static descriptor in the souffle_tests section, which the linker
+// brackets with __start_souffle_tests/__stop_souffle_tests: nothing runs at load time but one
+// constructor per file, registering the section of its module. Elsewhere (or with
+// SOUFFLE_NO_SECTIONS) every test registers itself from a constructor.
+#if defined(__ELF__) && !defined(SOUFFLE_NO_SECTIONS)
+extern Test __start_souffle_tests[] __attribute__((weak, visibility("hidden")));
+extern Test __stop_souffle_tests[] __attribute__((weak, visibility("hidden")));
+
+__attribute__((constructor)) static void
+souffle_register_section() {
+    register_tests(__start_souffle_tests, __stop_souffle_tests);
+}
+
+// The descriptors are laid out back to back: the explicit alignment keeps the compiler from
+// padding them to a larger one.
+#define SOUFFLE_REGISTER(suite, name, ...)                                                         \
+    __attribute__((used, section("souffle_tests"), aligned(_Alignof(Test)))) static Test           \
+        souffle_test_##suite##_##name = SOUFFLE_TEST_DESC(suite, name, __VA_ARGS__)
+#else
+#define SOUFFLE_REGISTER(suite, name, ...)                                                         \
+    static Test souffle_test_##suite##_##name;                                                     \
+    __attribute__((constructor)) static void reg_##suite##_##name() {                              \
+        register_tests(&souffle_test_##suite##_##name, &souffle_test_##suite##_##name + 1);        \
+    }                                                                                              \
+    static Test souffle_test_##suite##_##name = SOUFFLE_TEST_DESC(suite, name, __VA_ARGS__)
+#endif
+
+#define TEST(suite, name, ...)                                                                     \
     SETUP(suite, name);                                                                            \
     TEARDOWN(suite, name);                                                                         \
+    SUITE_SETUP(suite);                                                                            \
+    SUITE_TEARDOWN(suite);                                                                         \
     void suite##_##name([[maybe_unused]] StatusInfo *status_info, [[maybe_unused]] void **ctx);    \
-    __attribute__((constructor)) void reg_##suite##_##name() {                                     \
-        register_test(#suite, #name, suite##_##name, suite##_##name##_setup,                       \
-                      suite##_##name##_teardown);                                                  \
-    }                                                                                              \
+    SOUFFLE_REGISTER(suite, name, false, NULL, 0, 0, __VA_ARGS__);                                 \
     void suite##_##name([[maybe_unused]] StatusInfo *status_info, [[maybe_unused]] void **ctx)
 
+// A test run once for every row of `table`, a static array of parameter structs defined before
+// it. The body sees its row as `param`, and each row is reported as its own test, "name/row_<i>".
+// Rows run back to back in one process, which is only replaced when a row crashes.
+#define TEST_P(suite, name, table, ...)                                                            \
+    SETUP(suite, name);                                                                            \
+    TEARDOWN(suite, name);                                                                         \
+    SUITE_SETUP(suite);                                                                            \
+    SUITE_TEARDOWN(suite);                                                                         \
+    static void suite##_##name##_row(StatusInfo *status_info, void **ctx,                          \
+                                     const typeof((table)[0]) *param);                             \
+    void suite##_##name(StatusInfo *status_info, void **ctx) {                                     \
+        suite##_##name##_row(status_info, ctx, status_info->param);                                \
+    }                                                                                              \
+    SOUFFLE_REGISTER(suite, name, false, table, sizeof(table) / sizeof((table)[0]),                \
+                     sizeof((table)[0]), __VA_ARGS__);                                             \
+    static void suite##_##name##_row([[maybe_unused]] StatusInfo *status_info,                     \
+                                     [[maybe_unused]] void **ctx,                                  \
+                                     [[maybe_unused]] const typeof((table)[0]) *param)
+
+// A test whose body runs against many generated inputs, drawn with the GEN_* macros. The failing
+// input is shrunk and logged along with the SOUFFLE_SEED that reproduces it. SKIP_TEST() in the
+// body discards the input.
+#define PROPERTY(suite, name, ...)                                                                 \
+    SETUP(suite, name);                                                                            \
+    TEARDOWN(suite, name);                                                                         \
+    SUITE_SETUP(suite);                                                                            \
+    SUITE_TEARDOWN(suite);                                                                         \
+    static void suite##_##name##_prop(StatusInfo *status_info, void **ctx, SouffleGen *gen);       \
+    void suite##_##name(StatusInfo *status_info, void **ctx) {                                     \
+        souffle_property(status_info, ctx, suite##_##name##_prop, #suite "." #name);               \
+    }                                                                                              \
+    SOUFFLE_REGISTER(suite, name, false, NULL, 0, 0, __VA_ARGS__);                                 \
+    static void suite##_##name##_prop([[maybe_unused]] StatusInfo *status_info,                    \
+                                      [[maybe_unused]] void **ctx, [[maybe_unused]] SouffleGen *gen)
+
+// A benchmark: the body times its work with BENCH_LOOP. Benchmarks only run with SOUFFLE_BENCH=1,
+// one at a time, each in a process of its own, and log ns/op, median, MAD and p99. With
+// `.range = {min, max}` the body runs for each BENCH_ARG of the range.
+#define BENCH(suite, name, ...)                                                                    \
+    SETUP(suite, name);                                                                            \
+    TEARDOWN(suite, name);                                                                         \
+    SUITE_SETUP(suite);                                                                            \
+    SUITE_TEARDOWN(suite);                                                                         \
+    static void suite##_##name##_bench(StatusInfo *status_info, void **ctx, SouffleBench *bench);  \
+    void suite##_##name(StatusInfo *status_info, void **ctx);                                      \
+    SOUFFLE_REGISTER(suite, name, true, NULL, 0, 0, __VA_ARGS__);                                  \
+    void suite##_##name(StatusInfo *status_info, void **ctx) {                                     \
+        souffle_bench(status_info, ctx, suite##_##name##_bench, #suite "." #name,                  \
+                      souffle_test_##suite##_##name.options.range);                                \
+    }                                                                                              \
+    static void suite##_##name##_bench([[maybe_unused]] StatusInfo *status_info,                   \
+                                       [[maybe_unused]] void **ctx, SouffleBench *bench)
+
 #endif // SOUFFLE_H
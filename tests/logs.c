@@ -0,0 +1,54 @@
+// Logs 1 MiB from each of 300 tests: more than a slot's log region holds, so every log only arrives
+// whole if the runner gives the room of the logs it took back. The reporter below prints how many
+// arrived whole. Built and run by tests/run.sh.
+
+#include "../src/souffle.h"
+
+static void
+log_mib(StatusInfo *status_info) {
+    static char line[1 << 16];
+    memset(line, 'x', sizeof(line) - 2);
+    line[sizeof(line) - 2] = '\n';
+    for (int i = 0; i < 16; ++i) {
+        LOG_MSG("%s", line);
+    }
+    LOG_MSG("end of the log\n");
+}
+
+static void
+on_test_end(void *data, const TestResult *result) {
+    size_t len = result->msg ? strlen(result->msg) : 0;
+    const char *end = "end of the log\n";
+    size_t end_len = strlen(end);
+    if (!result->truncated && len > end_len && strcmp(result->msg + len - end_len, end) == 0) {
+        ++*(int *)data;
+    }
+}
+
+static void
+on_run_end(void *data, [[maybe_unused]] const RunSummary *summary) {
+    fprintf(stderr, "whole logs: %d\n", *(int *)data);
+}
+
+__attribute__((constructor)) static void
+add_reporter() {
+    static int whole;
+    register_reporter((TestReporter){
+        .on_test_end = on_test_end,
+        .on_run_end = on_run_end,
+        .data = &whole,
+    });
+}
+
+#define LOGS_1(n) \
+    TEST(logs, mib_##n) { log_mib(status_info); }
+#define LOGS_10(n)                                                                                 \
+    LOGS_1(n##0) LOGS_1(n##1) LOGS_1(n##2) LOGS_1(n##3) LOGS_1(n##4) LOGS_1(n##5) LOGS_1(n##6)     \
+    LOGS_1(n##7) LOGS_1(n##8) LOGS_1(n##9)
+#define LOGS_100(n)                                                                                \
+    LOGS_10(n##0) LOGS_10(n##1) LOGS_10(n##2) LOGS_10(n##3) LOGS_10(n##4) LOGS_10(n##5)            \
+    LOGS_10(n##6) LOGS_10(n##7) LOGS_10(n##8) LOGS_10(n##9)
+
+LOGS_100(1)
+LOGS_100(2)
+LOGS_100(3)
@@ -0,0 +1,219 @@
+#!/bin/sh
+# Behaviour checks for the runner. Each check builds one of the examples and runs it, looking at
+# the exit code and at the JSON Lines report rather than the console output:
+#
+#   $ tests/run.sh               # every check
+#   $ tests/run.sh history rerun # only these
+#
+# CC and CFLAGS pick the compiler and its flags (cc -g -O1 by default). POSIX only.
+
+set -u
+
+root=$(cd "$(dirname "$0")/.." && pwd)
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+CC=${CC:-cc}
+CFLAGS=${CFLAGS:--g -O1}
+failures=0
+
+fail() {
+    echo "FAIL [$check]: $*"
+    failures=$((failures + 1))
+}
+
+# build NAME [DIR]: compile DIR/NAME.c (examples/ by default) to $work/NAME.
+build() {
+    $CC $CFLAGS "$root/${2:-examples}/$1.c" "$root/src/souffle.c" "$root/src/hashy.c" \
+        -o "$work/$1" -lm || {
+        fail "${2:-examples}/$1.c does not build"
+        return 1
+    }
+}
+
+# expect_exit CODE NAME [ARG...]: run $work/NAME with the report in $work/report.jsonl.
+expect_exit() {
+    code=$1
+    shift
+    rm -f "$work/report.jsonl"
+    SOUFFLE_REPORT="jsonl:$work/report.jsonl" "$work/$@" >"$work/stdout" 2>"$work/stderr"
+    got=$?
+    [ "$got" -eq "$code" ] || fail "$* exited with $got, expected $code"
+}
+
+# status SUITE NAME: the status the last report gives SUITE.NAME, empty if it did not run.
+status() {
+    sed -n "s/.*\"suite\":\"$1\",\"name\":\"$2\",\"status\":\"\([a-z_]*\)\".*/\1/p" \
+        "$work/report.jsonl"
+}
+
+expect_status() {
+    got=$(status "$1" "$2")
+    [ "$got" = "$3" ] || fail "$1.$2 is '$got', expected '$3'"
+}
+
+check_history() {
+    build history || return
+    cd "$work" || return
+    for i in 1 2 3; do
+        SOUFFLE_HISTORY=history.bin expect_exit 0 history
+    done
+    # after 3 runs `usually_fast` times out at 1s instead of sleeping its 5s.
+    start=$(date +%s)
+    SOUFFLE_HISTORY=history.bin SLOWER=1 expect_exit 1 history
+    expect_status history usually_fast timeout
+    expect_status history slow passed
+    [ $(($(date +%s) - start)) -lt 4 ] || fail "the adaptive timeout did not apply"
+
+    # a file that is not a history is left alone.
+    echo "not a history" >notes.txt
+    SOUFFLE_HISTORY=notes.txt expect_exit 0 history
+    [ "$(cat notes.txt)" = "not a history" ] || fail "notes.txt was overwritten"
+    grep -q "not a timing history" stderr || fail "no warning about notes.txt"
+    cd "$root" || return
+}
+
+check_logs() {
+    build big_log || return
+    for mode in isolated server batch; do
+        SOUFFLE_MODE=$mode expect_exit 1 big_log
+        grep -q "line 99999 of the log" "$work/report.jsonl" ||
+            fail "the 100k line log is cut short in $mode mode"
+    done
+    # 300 MiB of logs through a single slot.
+    build logs tests || return
+    for mode in isolated server batch; do
+        SOUFFLE_MODE=$mode SOUFFLE_JOBS=1 SOUFFLE_QUIET=1 expect_exit 0 logs
+        grep -q "^whole logs: 300$" "$work/stderr" ||
+            fail "$mode mode: $(grep "whole logs" "$work/stderr") of 300"
+    done
+}
+
+check_server() {
+    build server tests || return
+    WORKER_PID_FILE="$work/worker" SOUFFLE_MODE=server SOUFFLE_JOBS=1 expect_exit 1 server
+    expect_status server first passed
+    expect_status server fresh_image passed
+    expect_status server crashes crashed
+    expect_status server same_worker_after_crash passed
+    expect_status server hangs timeout
+    expect_status server same_worker_after_timeout passed
+}
+
+# list_shards NAME COUNT: every shard's --list, one "shard test" per line.
+list_shards() {
+    shard=0
+    while [ "$shard" -lt "$2" ]; do
+        SOUFFLE_SHARD_INDEX=$shard SOUFFLE_SHARD_COUNT=$2 "$work/$1" --list | sed "s/^/$shard /"
+        shard=$((shard + 1))
+    done
+}
+
+check_sharding() {
+    build sharding || return
+    "$work/sharding" --list | sort >"$work/all"
+    for count in 1 2 3 4 9 12; do
+        list_shards sharding "$count" >"$work/shards"
+        cut -d' ' -f2 "$work/shards" | sort >"$work/covered"
+        [ -z "$(uniq -d "$work/covered")" ] || fail "$count shards overlap"
+        cmp -s "$work/all" "$work/covered" || fail "$count shards don't cover every test"
+    done
+    # equal shares without a history: 9 tests in 4 shards run 2 or 3 each.
+    for shard in 0 1 2 3; do
+        SOUFFLE_SHARD_INDEX=$shard SOUFFLE_SHARD_COUNT=4 expect_exit 0 sharding
+        ran=$(grep -c '"type":"test"' "$work/report.jsonl")
+        [ "$ran" -ge 2 ] && [ "$ran" -le 3 ] || fail "shard $shard of 4 ran $ran tests"
+    done
+
+    # with a history, `history.slow` (400ms) gets a shard of its own.
+    build history || return
+    cd "$work" || return
+    SOUFFLE_HISTORY=weights.bin expect_exit 0 history
+    [ "$(SOUFFLE_SHARD_INDEX=1 SOUFFLE_SHARD_COUNT=3 ./history --list)" != "history.slow" ] ||
+        fail "the shards are weighed without a history"
+    for count in 2 3; do
+        SOUFFLE_HISTORY=weights.bin list_shards history "$count" >"by_time.$count"
+        cut -d' ' -f2 "by_time.$count" | sort >covered
+        ./history --list | sort | cmp -s - covered || fail "$count weighted shards don't add up"
+    done
+    [ "$(grep -c '^1 ' by_time.3)" -eq 1 ] && grep -q '^1 history.slow$' by_time.3 ||
+        fail "history.slow does not have a shard of its own"
+    cd "$root" || return
+}
+
+check_rerun() {
+    build rerun || return
+    cd "$work" || return
+    SOUFFLE_HISTORY=rerun.bin expect_exit 1 rerun
+    expect_status rerun fixed_later failed
+    # only `fixed_later` runs again, the others passed in this very binary.
+    FIXED=1 SOUFFLE_HISTORY=rerun.bin SOUFFLE_RERUN=only-failed expect_exit 0 rerun
+    expect_status rerun fixed_later passed
+    grep -q '"name":"expensive","status":"passed","elapsed_ms":0,"cached":true' report.jsonl ||
+        fail "rerun.expensive was not cached"
+    grep -q '"name":"fixed_later",.*"cached":false' report.jsonl || fail "rerun.fixed_later was cached"
+    grep -q '"type":"run_end",.*"cached":2,' report.jsonl || fail "the summary doesn't count 2 cached"
+    # a rebuild that changes the binary runs everything.
+    echo "int rebuilt = 1;" >rebuilt.c
+    $CC $CFLAGS "$root/examples/rerun.c" "$root/src/souffle.c" "$root/src/hashy.c" rebuilt.c \
+        -o rerun -lm
+    FIXED=1 SOUFFLE_HISTORY=rerun.bin SOUFFLE_RERUN=only-failed expect_exit 0 rerun
+    grep -q '"cached":true' report.jsonl && fail "a different binary reused cached results"
+    cd "$root" || return
+}
+
+check_fail_fast() {
+    build fail_fast || return
+    # `broken` fails at 100ms while `long_running` sleeps 3s next to it: it is killed, and it and
+    # the three tests that never started are not run.
+    start=$(date +%s)
+    SOUFFLE_JOBS=2 SOUFFLE_FAIL_FAST=1 expect_exit 1 fail_fast
+    [ $(($(date +%s) - start)) -lt 3 ] || fail "the running test was not killed"
+    expect_status fail_fast broken failed
+    [ -z "$(status fail_fast long_running)$(status fail_fast never_reached)" ] ||
+        fail "tests after the failure were reported"
+    grep -q '"type":"run_end",.*"failed":1,.*"not_run":4}' "$work/report.jsonl" ||
+        fail "the summary doesn't count 4 tests not run"
+    grep -q "4 tests never run" "$work/stdout" || fail "the console doesn't say 4 never ran"
+    # without a limit everything runs.
+    SOUFFLE_JOBS=2 expect_exit 1 fail_fast
+    grep -q '"type":"run_end",.*"not_run":0}' "$work/report.jsonl" || fail "tests left out"
+}
+
+# expect_in FILE TEXT: FILE has a line holding TEXT.
+expect_in() {
+    grep -qF -- "$2" "$1" || fail "$(basename "$1") lacks: $2"
+}
+
+check_reporters() {
+    build reporters || return
+    cd "$work" || return
+    SOUFFLE_REPORT=junit:report.xml,tap:report.tap,jsonl:report.jsonl ./reporters \
+        >/dev/null 2>stderr
+    [ $? -eq 1 ] || fail "reporters should exit with 1"
+    expect_in report.xml '<testsuites tests="0000000005" failures="0000000001" errors="0000000000"'
+    expect_in report.xml '<testsuite name="codec" tests="0000000003" failures="0000000001"'
+    expect_in report.xml '<testcase classname="codec" name="decode" time="0.000">'
+    expect_in report.xml '<failure message="failed">'
+    expect_in report.xml '<skipped/>'
+    expect_in report.xml 'closing &lt;file&gt; &amp; &quot;friends&quot;'
+    expect_in report.tap '1..5'
+    expect_in report.tap 'not ok 2 - codec.decode'
+    expect_in report.tap 'ok 3 - codec.skipped # SKIP'
+    expect_in report.tap 'ok 5 - storage.close'
+    expect_in report.jsonl '{"type":"run_start","tests":5}'
+    expect_in report.jsonl '"message":"\t  closing <file> & \"friends\"\n"}'
+    expect_in report.jsonl '"type":"run_end","tests":5,"passed":3,"failed":1,"crashed":0,'
+    expect_in stderr '[tally] codec: 1 passed, 1 failed'
+    expect_in stderr '[tally] storage: 2 passed, 0 failed'
+    cd "$root" || return
+}
+
+checks=${*:-server logs history sharding rerun fail_fast reporters}
+for check in $checks; do
+    "check_$check"
+done
+if [ "$failures" -gt 0 ]; then
+    echo "$failures check(s) failed"
+    exit 1
+fi
+echo "all checks passed"
@@ -0,0 +1,45 @@
+// SOUFFLE_MODE=server with SOUFFLE_JOBS=1: every test is forked from the same worker, which outlives
+// a crash and a timeout, and no test sees what an earlier one did to its memory. WORKER_PID_FILE
+// names a file for the tests to compare their parent in. Built and run by tests/run.sh.
+
+#include <signal.h>
+#include <unistd.h>
+
+#include "../src/souffle.h"
+
+static int touched = 0;
+
+static long
+saved_worker() {
+    FILE *file = fopen(getenv("WORKER_PID_FILE"), "r");
+    long pid = -1;
+    if (file) {
+        if (fscanf(file, "%ld", &pid) != 1) {
+            pid = -1;
+        }
+        fclose(file);
+    }
+    return pid;
+}
+
+TEST(server, first) {
+    FILE *file = fopen(getenv("WORKER_PID_FILE"), "w");
+    ASSERT_NOT_NULL(file);
+    fprintf(file, "%ld\n", (long)getppid());
+    fclose(file);
+    touched = 1;
+}
+
+TEST(server, fresh_image) { ASSERT_EQ(touched, 0); }
+
+TEST(server, crashes) { raise(SIGSEGV); }
+
+TEST(server, same_worker_after_crash) { ASSERT_EQ((long)getppid(), saved_worker()); }
+
+TEST(server, hangs, .timeout_ms = 200) {
+    while (true) {
+        pause();
+    }
+}
+
+TEST(server, same_worker_after_timeout) { ASSERT_EQ((long)getppid(), saved_worker()); }